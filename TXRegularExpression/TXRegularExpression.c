@@ -1,4 +1,17 @@
 #include <CoreFoundation/CoreFoundation.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 #include "TXRegularExpression.h"
 #include "icu_regex.h"
 
@@ -10,6 +23,310 @@
 
 #define TXRegexGetStruct(x) (TXRegexStruct *)CFDataGetBytePtr(x);
 
+static int TXRegexStatisticsEnabled = 0;
+
+static Boolean TXRegexStatisticsIsEnabled(void)
+{
+	return __atomic_load_n(&TXRegexStatisticsEnabled, __ATOMIC_RELAXED);
+}
+
+/*
+ The counters of a pattern. Copies of a regular expression share them with the original,
+ so they are counted per pattern whichever copy runs the search.
+ */
+typedef struct TXRegexStatisticsBlock {
+	TXRegexStatistics counters;
+	int retainCount;
+} TXRegexStatisticsBlock;
+
+static TXRegexStatisticsBlock *TXRegexStatisticsBlockCreate(void)
+{
+	TXRegexStatisticsBlock *block = calloc(1, sizeof(TXRegexStatisticsBlock));
+	if (block) block->retainCount = 1;
+	return block;
+}
+
+static TXRegexStatisticsBlock *TXRegexStatisticsBlockRetain(TXRegexStatisticsBlock *block)
+{
+	if (block) __atomic_add_fetch(&block->retainCount, 1, __ATOMIC_RELAXED);
+	return block;
+}
+
+static void TXRegexStatisticsBlockRelease(TXRegexStatisticsBlock *block)
+{
+	if (block && !__atomic_sub_fetch(&block->retainCount, 1, __ATOMIC_ACQ_REL)) free(block);
+}
+
+// Makes regexp_struct count into block. Nothing changes when block is NULL.
+static void TXRegexShareStatistics(TXRegexStruct *regexp_struct, TXRegexStatisticsBlock *block)
+{
+	if (!block || (block == regexp_struct->statistics)) return;
+	TXRegexStatisticsBlockRelease(regexp_struct->statistics);
+	regexp_struct->statistics = TXRegexStatisticsBlockRetain(block);
+}
+
+#define TXRegexStatisticsAdd(regexp_struct, field, value) \
+	__atomic_add_fetch(&(regexp_struct)->statistics->counters.field, (value), __ATOMIC_RELAXED)
+
+// Never 0.
+static uint64_t TXRegexNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec + 1;
+}
+
+// Returns 0 when statistics are disabled, so that nothing is recorded with the returned time.
+static uint64_t TXRegexStatisticsStartTime(void)
+{
+	if (!TXRegexStatisticsIsEnabled()) return 0;
+	return TXRegexNanoseconds();
+}
+
+static CFIndex TXRegexStatisticsElapsed(uint64_t startTime)
+{
+	return (CFIndex)(TXRegexNanoseconds() - startTime);
+}
+
+// The compile time is recorded even while statistics are disabled, since it is measured only once per pattern.
+static void TXRegexStatisticsSetCompileTime(TXRegexStruct *regexp_struct, uint64_t startTime)
+{
+	__atomic_store_n(&regexp_struct->statistics->counters.compileNanoseconds,
+					 TXRegexStatisticsElapsed(startTime), __ATOMIC_RELAXED);
+}
+
+static Boolean TXRegexIsLimitError(UErrorCode status)
+{
+	return (U_REGEX_TIME_OUT == status) || (U_REGEX_STACK_OVERFLOW == status) || (U_REGEX_STOPPED_BY_CALLER == status);
+}
+
+static void TXRegexStatisticsRecordSearch(TXRegexStruct *regexp_struct, uint64_t startTime, UBool found,
+										  UErrorCode status)
+{
+	if (!startTime) return;
+	if (TXRegexIsLimitError(status)) TXRegexStatisticsAdd(regexp_struct, limitTrips, 1);
+	TXRegexStatisticsAdd(regexp_struct, searchNanoseconds, TXRegexStatisticsElapsed(startTime));
+	TXRegexStatisticsAdd(regexp_struct, searches, 1);
+	if (found) TXRegexStatisticsAdd(regexp_struct, matches, 1);
+}
+
+/*
+ Offsets in a UTF-8 target are converted by counting characters from the pair of offsets
+ converted last time, so converting nearby offsets costs only the distance between them.
+ */
+static int64_t TXRegexUTF16OffsetFromByteOffset(TXRegexStruct *regexp_struct, int64_t offset)
+{
+	const UInt8 *bytes = CFDataGetBytePtr(regexp_struct->targetBytes);
+	int64_t n = regexp_struct->anchorByteOffset;
+	int64_t utf16_offset = regexp_struct->anchorUTF16Offset;
+	if (offset < n - offset) {
+		n = 0;
+		utf16_offset = 0;
+	}
+	for (; n < offset; n++) {
+		if (0x80 != (bytes[n] & 0xC0)) utf16_offset += (bytes[n] >= 0xF0) ? 2 : 1;
+	}
+	for (; n > offset; n--) {
+		if (0x80 != (bytes[n-1] & 0xC0)) utf16_offset -= (bytes[n-1] >= 0xF0) ? 2 : 1;
+	}
+	regexp_struct->anchorByteOffset = offset;
+	regexp_struct->anchorUTF16Offset = utf16_offset;
+	return utf16_offset;
+}
+
+static int64_t TXRegexByteOffsetFromUTF16Offset(TXRegexStruct *regexp_struct, int64_t offset)
+{
+	const UInt8 *bytes = CFDataGetBytePtr(regexp_struct->targetBytes);
+	int64_t length = CFDataGetLength(regexp_struct->targetBytes);
+	int64_t n = regexp_struct->anchorByteOffset;
+	int64_t utf16_offset = regexp_struct->anchorUTF16Offset;
+	if (offset < utf16_offset - offset) {
+		n = 0;
+		utf16_offset = 0;
+	}
+	while ((utf16_offset < offset) && (n < length)) {
+		utf16_offset += (bytes[n] >= 0xF0) ? 2 : 1;
+		for (n++; (n < length) && (0x80 == (bytes[n] & 0xC0)); n++);
+	}
+	while ((utf16_offset > offset) && (n > 0)) {
+		for (n--; (n > 0) && (0x80 == (bytes[n] & 0xC0)); n--);
+		utf16_offset -= (bytes[n] >= 0xF0) ? 2 : 1;
+	}
+	regexp_struct->anchorByteOffset = n;
+	regexp_struct->anchorUTF16Offset = utf16_offset;
+	// an offset beyond the end is kept out of range.
+	return (utf16_offset < offset) ? n + (offset - utf16_offset) : n;
+}
+
+// Convert a native offset of ICU into the offset reported to the caller.
+static int64_t TXRegexReportedOffset(TXRegexStruct *regexp_struct, int64_t offset)
+{
+	if (!regexp_struct->targetBytes || (kTXRegexOffsetUTF8Bytes == regexp_struct->offsetUnit) || (offset < 0)) {
+		return offset;
+	}
+	return TXRegexUTF16OffsetFromByteOffset(regexp_struct, offset);
+}
+
+static int64_t TXRegexNativeOffset(TXRegexStruct *regexp_struct, int64_t offset)
+{
+	if (!regexp_struct->targetBytes || (kTXRegexOffsetUTF8Bytes == regexp_struct->offsetUnit) || (offset < 0)) {
+		return offset;
+	}
+	return TXRegexByteOffsetFromUTF16Offset(regexp_struct, offset);
+}
+
+/*
+ Apply the region of regexp_struct to the current target of length in native units.
+ A region beyond the end of the target is clipped.
+ */
+static void TXRegexApplyRegion(TXRegexStruct *regexp_struct, int64_t length, UErrorCode *status)
+{
+	URegularExpression *re = regexp_struct->uregexp;
+	Boolean had_region = (regexp_struct->regionStart >= 0);
+	regexp_struct->regionStart = -1;
+	regexp_struct->regionLimit = -1;
+	if (kCFNotFound == regexp_struct->region.location) {
+		if (had_region) uregex_reset(re, 0, status);
+		return;
+	}
+	int64_t start = TXRegexNativeOffset(regexp_struct, regexp_struct->region.location);
+	int64_t limit = TXRegexNativeOffset(regexp_struct, regexp_struct->region.location + regexp_struct->region.length);
+	if (start > length) start = length;
+	if (limit > length) limit = length;
+	uregex_useTransparentBounds(re, regexp_struct->regionTransparentBounds, status);
+	uregex_useAnchoringBounds(re, regexp_struct->regionAnchoringBounds, status);
+	uregex_setRegionAndStart(re, start, limit, start, status);
+	if (U_ZERO_ERROR != *status) return;
+	regexp_struct->regionStart = start;
+	regexp_struct->regionLimit = limit;
+}
+
+static Boolean UniCharsHaveLiteralAt(const UniChar *uchars, CFIndex index, const UniChar *literal, CFIndex literalLength)
+{
+	// the first and the last characters have been compared.
+	return (literalLength <= 2) || !memcmp(uchars + index + 1, literal + 1, (literalLength - 2) * sizeof(UniChar));
+}
+
+/*
+ Find literal in uchars at or after start. Blocks of characters at candidate positions and at
+ candidate positions + literalLength - 1 are compared with the first and the last characters of
+ literal at once, so only positions where both characters match are compared further.
+ */
+static CFIndex TXRegexFindLiteral(const UniChar *uchars, CFIndex length, CFIndex start,
+								  const UniChar *literal, CFIndex literalLength)
+{
+	CFIndex last = length - literalLength; // the last position where literal can start.
+	CFIndex n = start;
+	UniChar first_char = literal[0];
+	UniChar last_char = literal[literalLength - 1];
+#if defined(__AVX2__)
+	const __m256i first_block = _mm256_set1_epi16((short)first_char);
+	const __m256i last_block = _mm256_set1_epi16((short)last_char);
+	for (; n + 16 <= last + 1; n += 16) {
+		__m256i block_at_first = _mm256_loadu_si256((const __m256i *)(uchars + n));
+		__m256i block_at_last = _mm256_loadu_si256((const __m256i *)(uchars + n + literalLength - 1));
+		__m256i equal = _mm256_and_si256(_mm256_cmpeq_epi16(block_at_first, first_block),
+										 _mm256_cmpeq_epi16(block_at_last, last_block));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(equal);
+		while (mask) {
+			CFIndex candidate = n + __builtin_ctz(mask) / 2;
+			if (UniCharsHaveLiteralAt(uchars, candidate, literal, literalLength)) return candidate;
+			mask &= mask - 1; // each character sets two bits.
+			mask &= mask - 1;
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i first_block_128 = _mm_set1_epi16((short)first_char);
+	const __m128i last_block_128 = _mm_set1_epi16((short)last_char);
+	for (; n + 8 <= last + 1; n += 8) {
+		__m128i block_at_first = _mm_loadu_si128((const __m128i *)(uchars + n));
+		__m128i block_at_last = _mm_loadu_si128((const __m128i *)(uchars + n + literalLength - 1));
+		__m128i equal = _mm_and_si128(_mm_cmpeq_epi16(block_at_first, first_block_128),
+									  _mm_cmpeq_epi16(block_at_last, last_block_128));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(equal);
+		while (mask) {
+			CFIndex candidate = n + __builtin_ctz(mask) / 2;
+			if (UniCharsHaveLiteralAt(uchars, candidate, literal, literalLength)) return candidate;
+			mask &= mask - 1;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; n <= last; n++) {
+		if ((uchars[n] == first_char) && (uchars[n + literalLength - 1] == last_char)
+			&& UniCharsHaveLiteralAt(uchars, n, literal, literalLength)) return n;
+	}
+	return kCFNotFound;
+}
+
+/*
+ Searches with the required literal of the pattern. A target without the literal after startIndex
+ is rejected before ICU runs, and ICU starts at the literal when every match starts with it.
+ With a region, a search before the region starts at the region, because uregex_find64 would reset it.
+ */
+static UBool TXRegexFind(TXRegexStruct *regexp_struct, CFIndex startIndex, UErrorCode *status)
+{
+	URegularExpression *re = regexp_struct->uregexp;
+	Boolean has_region = (regexp_struct->regionStart >= 0);
+	regexp_struct->searchStart = -1;
+	int64_t native_start = TXRegexNativeOffset(regexp_struct, startIndex);
+	if (has_region && (native_start < regexp_struct->regionStart)) native_start = regexp_struct->regionStart;
+	if (has_region && (native_start > regexp_struct->regionLimit)) {
+		uregex_setRegionAndStart(re, regexp_struct->regionStart, regexp_struct->regionLimit,
+								 regexp_struct->regionLimit, status);
+		return false;
+	}
+	if (regexp_struct->literalLength && regexp_struct->targetString) {
+		// offsets of a CFString target are native.
+		startIndex = (CFIndex)native_start;
+		int32_t length;
+		const UniChar *uchars = uregex_getText(re, &length, status);
+		if (U_ZERO_ERROR != *status) return false;
+		if (has_region) length = (int32_t)regexp_struct->regionLimit;
+		if ((0 <= startIndex) && (startIndex <= length)) {
+			CFIndex found = TXRegexFindLiteral(uchars, length, startIndex,
+											   regexp_struct->literalChars, regexp_struct->literalLength);
+			if (kCFNotFound == found) {
+				// leave the matcher at the end, so that uregex_findNext fails too.
+				if (has_region) {
+					uregex_setRegionAndStart(re, regexp_struct->regionStart, length, length, status);
+				} else {
+					uregex_reset(re, length, status);
+				}
+				if (TXRegexStatisticsIsEnabled()) TXRegexStatisticsAdd(regexp_struct, literalRejections, 1);
+				return false;
+			}
+			if (regexp_struct->literalIsPrefix) native_start = found;
+		}
+	}
+	uint64_t start_time = TXRegexStatisticsStartTime();
+	UBool result = false;
+	if (has_region) {
+		uregex_setRegionAndStart(re, regexp_struct->regionStart, regexp_struct->regionLimit, native_start, status);
+		if (U_ZERO_ERROR == *status) result = uregex_findNext(re, status);
+	} else {
+		result = uregex_find64(re, native_start, status);
+	}
+	TXRegexStatisticsRecordSearch(regexp_struct, start_time, result, *status);
+	return result;
+}
+
+static UBool TXRegexFindNext(TXRegexStruct *regexp_struct, UErrorCode *status)
+{
+	if (regexp_struct->literalLength && regexp_struct->targetString) {
+		// a match containing the literal is never empty, so the next search starts at the end of the match.
+		UErrorCode end_status = U_ZERO_ERROR;
+		int64_t end = uregex_end64(regexp_struct->uregexp, 0, &end_status);
+		if (U_ZERO_ERROR == end_status) return TXRegexFind(regexp_struct, (CFIndex)end, status);
+		if (regexp_struct->searchStart >= 0) return TXRegexFind(regexp_struct, regexp_struct->searchStart, status);
+	}
+	uint64_t start_time = TXRegexStatisticsStartTime();
+	UBool result = uregex_findNext(regexp_struct->uregexp, status);
+	TXRegexStatisticsRecordSearch(regexp_struct, start_time, result, *status);
+	return result;
+}
+
 CFStringRef CFStringRetainAndGetUTF16Ptr(CFStringRef text, UniChar **outptr, CFIndex *length)
 {
 	CFStringRef result = NULL;
@@ -40,18 +357,55 @@ CFStringRef CFStringCreateWithRegexGroupWithLength(TXRegexRef regexp,
 	CFStringRef result = NULL;
 	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
 	URegularExpression *re = regexp_struct->uregexp;
+	CFAllocatorRef allocator = regexp_struct->resultAllocator;
 	int32_t buffer_size = (int32_t)(len + 1) * sizeof(UniChar); // without character length + 1 cause malloc error.
-	UChar *buffer = malloc(buffer_size);
+	UChar *buffer = CFAllocatorAllocate(allocator, buffer_size, 0);
+	if (!buffer) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
 	int32_t returned_size = uregex_group(re, (int32_t)gnum, buffer, buffer_size, status);
 	if (returned_size) {
-		result = CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, buffer,
-                                                    len, kCFAllocatorMalloc);
+		// len is a length in bytes for a UTF-8 target.
+		result = CFStringCreateWithCharactersNoCopy(allocator, buffer, returned_size, allocator);
 	} else {
-		free(buffer);
+		CFAllocatorDeallocate(allocator, buffer);
+		if (U_ZERO_ERROR == *status) result = CFRetain(CFSTR("")); // an empty group
 	}
 	return result;
 }
 
+/*
+ Make a string of a group from the target without uregex_group, for kTXRegexGroupSubstring.
+ start and end are native offsets of ICU.
+ */
+static CFStringRef TXRegexCreateGroupSubstring(CFAllocatorRef allocator, TXRegexStruct *regexp_struct,
+											   int64_t start, int64_t end, UErrorCode *status)
+{
+	if (start == end) return CFRetain(CFSTR(""));
+	if (regexp_struct->targetBytes) {
+		return CFStringCreateWithBytes(allocator, CFDataGetBytePtr(regexp_struct->targetBytes) + start,
+									   (CFIndex)(end - start), kCFStringEncodingUTF8, false);
+	}
+	if (!regexp_struct->targetCopied) {
+		return CFStringCreateWithSubstring(allocator, regexp_struct->targetString,
+										   CFRangeMake((CFIndex)start, (CFIndex)(end - start)));
+	}
+	const UniChar *uchars = uregex_getText(regexp_struct->uregexp, NULL, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	return CFStringCreateWithCharacters(allocator, uchars + start, (CFIndex)(end - start));
+}
+
+static CFStringRef TXRegexCreateGroupString(TXRegexRef regexp, int32_t gnum, int64_t start, int64_t end,
+											UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (kTXRegexGroupSubstring == regexp_struct->groupMode) {
+		return TXRegexCreateGroupSubstring(regexp_struct->resultAllocator, regexp_struct, start, end, status);
+	}
+	return CFStringCreateWithRegexGroupWithLength(regexp, gnum, (CFIndex)(end-start), status);
+}
+
 CFArrayRef CFArrayCreateWithCapturedGroups(TXRegexRef regexp, UErrorCode *status)
 {
 	CFMutableArrayRef result = NULL;
@@ -59,17 +413,17 @@ CFArrayRef CFArrayCreateWithCapturedGroups(TXRegexRef regexp, UErrorCode *status
 	URegularExpression *re = regexp_struct->uregexp;
 	int32_t gcount = uregex_groupCount(re, status) + 1;
 	if (U_ZERO_ERROR != *status) return NULL;
-	result = CFArrayCreateMutable(kCFAllocatorDefault, gcount, &kCFTypeArrayCallBacks);
+	result = CFArrayCreateMutable(regexp_struct->resultAllocator, gcount, &kCFTypeArrayCallBacks);
 	for (int n = 0; n < gcount; n++) {
-		int32_t start = uregex_start(re, n, status);
+		int64_t start = uregex_start64(re, n, status);
 		if (U_ZERO_ERROR != *status) goto bail;
-		int32_t end = uregex_end(re, n, status);
+		int64_t end = uregex_end64(re, n, status);
 		if (U_ZERO_ERROR != *status) goto bail;
 		CFStringRef text = NULL;
         if (-1 == start) {
 			text = CFSTR("");
 		} else {
-			text = CFStringCreateWithRegexGroupWithLength(regexp, n, end-start, status);
+			text = TXRegexCreateGroupString(regexp, n, start, end, status);
             if (!text) {
                 fprintf(stderr, "Failed to create CFString\n");
                 goto bail;
@@ -82,6 +436,21 @@ bail:
 	return result;	
 }
 
+static CFDictionaryRef CFDictionaryCreateWithCapturedGroup(CFAllocatorRef allocator, int64_t start, int64_t end,
+														   CFStringRef text)
+{
+	CFStringRef keys[] = {CFSTR("start"), CFSTR("end"), CFSTR("text")};
+	CFTypeRef values[3];
+	values[0] = CFNumberCreate(allocator, kCFNumberSInt64Type, &start);
+	values[1] = CFNumberCreate(allocator, kCFNumberSInt64Type, &end);
+	values[2] = text;
+	CFDictionaryRef dict = CFDictionaryCreate(allocator, (void *)keys, (void *)values, 3,  
+											  &kCFTypeDictionaryKeyCallBacks,  &kCFTypeDictionaryValueCallBacks);
+	CFRelease(values[0]);
+	CFRelease(values[1]);
+	return dict;
+}
+
 CFArrayRef TXRegexCapturedGroups(TXRegexRef regexp, UErrorCode *status)
 {
 	CFMutableArrayRef result = NULL;
@@ -89,121 +458,3868 @@ CFArrayRef TXRegexCapturedGroups(TXRegexRef regexp, UErrorCode *status)
 	URegularExpression *re = regexp_struct->uregexp;
 	int32_t gcount = uregex_groupCount(re, status) + 1;
 	if (U_ZERO_ERROR != *status) goto bail;
-	result = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
-	CFStringRef keys[] = {CFSTR("start"), CFSTR("end"), CFSTR("text")};
+	result = CFArrayCreateMutable(regexp_struct->resultAllocator, 0, &kCFTypeArrayCallBacks);
 	for (int n = 0; n < gcount; n++) {
-		CFTypeRef values[3];
-		int32_t start = uregex_start(re, n, status);
+		int64_t start = uregex_start64(re, n, status);
 		if (U_ZERO_ERROR != *status) goto bail;
-		int32_t end = uregex_end(re, n, status);
+		int64_t end = uregex_end64(re, n, status);
 		if (U_ZERO_ERROR != *status) goto bail;
-		values[0] = CFNumberCreate(kCFAllocatorDefault, kCFNumberCFIndexType, &start);
-		values[1] = CFNumberCreate(kCFAllocatorDefault, kCFNumberCFIndexType, &end);
+		CFStringRef text = NULL;
 		if (-1 == start) {
-			values[2] = CFSTR("");
+			text = CFRetain(CFSTR(""));
 		} else {
-			values[2] = CFStringCreateWithRegexGroupWithLength(regexp, n, end-start, status);
+			text = TXRegexCreateGroupString(regexp, n, start, end, status);
+			start = TXRegexReportedOffset(regexp_struct, start);
+			end = TXRegexReportedOffset(regexp_struct, end);
 		}
-		CFDictionaryRef dict = CFDictionaryCreate(kCFAllocatorDefault, (void *)keys, (void *)values, 3,  
-												  &kCFTypeDictionaryKeyCallBacks,  &kCFTypeDictionaryValueCallBacks);
+		CFDictionaryRef dict = CFDictionaryCreateWithCapturedGroup(regexp_struct->resultAllocator, start, end, text);
 		CFArrayAppendValue(result, dict);
 		CFRelease(dict);
-		CFRelease(values[0]);
-		CFRelease(values[2]);
-		CFRelease(values[1]);
+		CFRelease(text);
 	}
 bail:
 	return result;
 }
 
-#pragma mark Regex functions
+#pragma mark pattern analysis
 
-CFIndex TXRegexSetString(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+static Boolean IsASCIIAlphanumeric(UniChar c)
+{
+	return (('0' <= c) && (c <= '9')) || (('a' <= c) && (c <= 'z')) || (('A' <= c) && (c <= 'Z'));
+}
+
+// Skip a quantifier at *index and return its minimum count. 1 is returned when there is no quantifier.
+static CFIndex SkipQuantifier(const UniChar *uchars, CFIndex length, CFIndex *index)
+{
+	CFIndex n = *index;
+	CFIndex min_count = 1;
+	if (n >= length) return 1;
+	switch (uchars[n]) {
+		case '*':
+		case '?':
+			min_count = 0;
+			n++;
+			break;
+		case '+':
+			n++;
+			break;
+		case '{':
+			min_count = 0;
+			for (n++; (n < length) && ('0' <= uchars[n]) && (uchars[n] <= '9'); n++) {
+				min_count = min_count*10 + (uchars[n] - '0');
+			}
+			while ((n < length) && ('}' != uchars[n])) n++;
+			n++;
+			break;
+		default:
+			return 1;
+	}
+	if ((n < length) && (('?' == uchars[n]) || ('+' == uchars[n]))) n++; // lazy or possessive
+	*index = n;
+	return min_count;
+}
+
+// Skip a character class starting with '['. Classes may be nested in ICU.
+static CFIndex SkipCharacterClass(const UniChar *uchars, CFIndex length, CFIndex n)
+{
+	CFIndex depth = 0;
+	while (n < length) {
+		UniChar c = uchars[n];
+		if ('\\' == c) {
+			n += 2;
+			continue;
+		}
+		if ('[' == c) {
+			depth++;
+			n++;
+			if ((n < length) && ('^' == uchars[n])) n++;
+			if ((n < length) && (']' == uchars[n])) n++; // a leading ']' is a literal.
+			continue;
+		}
+		n++;
+		if ((']' == c) && (0 == --depth)) break;
+	}
+	return n;
+}
+
+// Skip an escape sequence other than an escaped meta character.
+static CFIndex SkipEscape(const UniChar *uchars, CFIndex length, CFIndex n)
+{
+	UniChar c = uchars[n+1];
+	n += 2;
+	switch (c) {
+		case 'x':
+		case 'N':
+		case 'p':
+		case 'P':
+			if ((n < length) && ('{' == uchars[n])) {
+				while ((n < length) && ('}' != uchars[n])) n++;
+				return n+1;
+			}
+			return ('x' == c) ? n+2 : n+1;
+		case 'u':
+			return n+4;
+		case 'U':
+			return n+8;
+		case 'c':
+			return n+1;
+		case 'k':
+			while ((n < length) && ('>' != uchars[n])) n++;
+			return n+1;
+		case 'Q':
+			while ((n+1 < length) && !(('\\' == uchars[n]) && ('E' == uchars[n+1]))) n++;
+			return n+2;
+		case '0':
+			for (CFIndex digits = 0; (digits < 3) && (n < length) && ('0' <= uchars[n]) && (uchars[n] <= '7'); digits++) n++;
+			return n;
+		default:
+			if (('1' <= c) && (c <= '9')) {
+				while ((n < length) && ('0' <= uchars[n]) && (uchars[n] <= '9')) n++;
+			}
+			return n;
+	}
+}
+
+/*
+ Extract the longest string which every match of a pattern must contain. Only a sequence of
+ literal characters at the top level of the pattern is considered. Groups, classes and escapes
+ end a sequence, and NULL is returned for a top-level alternation or case-insensitive matching.
+ */
+static CFStringRef CFStringCreateWithRequiredLiteral(CFStringRef pattern, uint32_t options, Boolean *isPrefix)
 {
+	if (isPrefix) *isPrefix = false;
+	if (options & (UREGEX_CASE_INSENSITIVE | UREGEX_COMMENTS | UREGEX_CANON_EQ)) return NULL;
+	if (options & UREGEX_LITERAL) {
+		if (isPrefix) *isPrefix = true;
+		return CFStringGetLength(pattern) ? CFRetain(pattern) : NULL;
+	}
 	UniChar *uchars = NULL;
 	CFIndex length = 0;
-	CFStringRef text_retained = CFStringRetainAndGetUTF16Ptr(text, &uchars, &length);
-	if (!text_retained) return 0;
-	TXRegexStruct* regex_struct = TXRegexGetStruct(regexp);
-	if (regex_struct->targetString) {
-#if useLog
-		fputs("before uregex_reset\n", stderr);
-#endif		
-		uregex_reset(regex_struct->uregexp, 0, status);
-		if (U_ZERO_ERROR != *status) goto bail;
-		CFRelease(regex_struct->targetString);
+	CFStringRef pattern_retained = CFStringRetainAndGetUTF16Ptr(pattern, &uchars, &length);
+	if (!pattern_retained) return NULL;
+	CFStringRef result = NULL;
+	CFIndex run_length = 0, best_length = 0;
+	Boolean run_is_prefix = true, best_is_prefix = false;
+	UniChar *run = malloc((length+1) * sizeof(UniChar));
+	UniChar *best = malloc((length+1) * sizeof(UniChar));
+	if (!run || !best) goto bail;
+	
+	CFIndex n = 0;
+	while (n < length) {
+		UniChar c = uchars[n];
+		CFIndex atom_length = 1; // 0 for an atom which is not a literal.
+		switch (c) {
+			case '|':
+			case ')':
+			case '*':
+			case '+':
+			case '?':
+			case '{':
+				goto bail;
+			case '(':
+				if ((n+2 < length) && ('?' == uchars[n+1])) {
+					// inline flags turning on case-insensitive or comments mode.
+					for (CFIndex k = n+2; (k < length) && (IsASCIIAlphanumeric(uchars[k]) || ('-' == uchars[k])); k++) {
+						if (('i' == uchars[k]) || ('x' == uchars[k])) goto bail;
+					}
+				}
+				for (CFIndex depth = 0; n < length; ) {
+					if ('\\' == uchars[n]) {
+						n += 2;
+					} else if ('[' == uchars[n]) {
+						n = SkipCharacterClass(uchars, length, n);
+					} else {
+						if ('(' == uchars[n]) depth++;
+						n++;
+						if ((')' == uchars[n-1]) && (0 == --depth)) break;
+					}
+				}
+				atom_length = 0;
+				break;
+			case '[':
+				n = SkipCharacterClass(uchars, length, n);
+				atom_length = 0;
+				break;
+			case '.':
+			case '^':
+			case '$':
+				n++;
+				atom_length = 0;
+				break;
+			case '\\':
+				if (n+1 >= length) goto bail;
+				if ((uchars[n+1] < 0x80) && !IsASCIIAlphanumeric(uchars[n+1])) {
+					run[run_length] = uchars[n+1]; // an escaped meta character
+					n += 2;
+				} else {
+					n = SkipEscape(uchars, length, n);
+					atom_length = 0;
+				}
+				break;
+			default:
+				run[run_length] = c;
+				n++;
+				if ((0xD800 == (c & 0xFC00)) && (n < length) && (0xDC00 == (uchars[n] & 0xFC00))) {
+					run[run_length+1] = uchars[n];
+					n++;
+					atom_length = 2;
+				}
+				break;
+		}
+		CFIndex atom_end = n;
+		CFIndex min_count = SkipQuantifier(uchars, length, &n);
+		if (atom_length && min_count) run_length += atom_length;
+		if (!atom_length || (atom_end != n)) {
+			// the sequence ends at a non-literal, optional or repeated atom.
+			if (run_length > best_length) {
+				memcpy(best, run, run_length * sizeof(UniChar));
+				best_length = run_length;
+				best_is_prefix = run_is_prefix;
+			}
+			run_length = 0;
+			run_is_prefix = false;
+		}
+	}
+	if (run_length > best_length) {
+		memcpy(best, run, run_length * sizeof(UniChar));
+		best_length = run_length;
+		best_is_prefix = run_is_prefix;
+	}
+	if (best_length) {
+		result = CFStringCreateWithCharacters(kCFAllocatorDefault, best, best_length);
+		if (isPrefix) *isPrefix = best_is_prefix;
+	}
+bail:
+	CFRelease(pattern_retained);
+	free(run);
+	free(best);
+	return result;
+}
+
+static Boolean IsASCIILetter(UniChar c)
+{
+	return (('a' <= c) && (c <= 'z')) || (('A' <= c) && (c <= 'Z'));
+}
+
+/*
+ Find whether a whole pattern is a literal, optionally anchored with ^ and $, and store the literal
+ in regexp_struct. Escaped meta characters, \Q...\E and \t \n \r \f are literal characters.
+ A case-insensitive pattern is a literal only when it consists of ASCII characters.
+ */
+static void TXRegexAnalyzeLiteralPattern(TXRegexStruct *regexp_struct, const UniChar *uchars, CFIndex length,
+										 uint32_t options)
+{
+	regexp_struct->literalKind = kTXRegexNotLiteral;
+	if (options & (UREGEX_COMMENTS | UREGEX_CANON_EQ)) return;
+	if (!length) return;
+	UniChar *literal = malloc(length * sizeof(UniChar));
+	if (!literal) return;
+	CFIndex literal_length = 0;
+	Boolean prefix = false, suffix = false;
+	CFIndex n = 0;
+	if (options & UREGEX_LITERAL) {
+		memcpy(literal, uchars, length * sizeof(UniChar));
+		literal_length = length;
+		n = length;
+	} else if ('^' == uchars[0]) {
+		prefix = true;
+		n = 1;
+	}
+	while (n < length) {
+		UniChar c = uchars[n];
+		switch (c) {
+			case '$':
+				if (n+1 != length) goto bail;
+				suffix = true;
+				n++;
+				break;
+			case '.': case '^': case '|': case '?': case '*': case '+':
+			case '(': case ')': case '[': case ']': case '{': case '}':
+				goto bail;
+			case '\\':
+				if (n+1 >= length) goto bail;
+				c = uchars[n+1];
+				n += 2;
+				if ('Q' == c) {
+					while ((n < length) && !(('\\' == uchars[n]) && (n+1 < length) && ('E' == uchars[n+1]))) {
+						literal[literal_length++] = uchars[n++];
+					}
+					n += 2;
+				} else if ('t' == c) {
+					literal[literal_length++] = '\t';
+				} else if ('n' == c) {
+					literal[literal_length++] = '\n';
+				} else if ('r' == c) {
+					literal[literal_length++] = '\r';
+				} else if ('f' == c) {
+					literal[literal_length++] = '\f';
+				} else if ((c < 0x80) && !IsASCIIAlphanumeric(c)) {
+					literal[literal_length++] = c;
+				} else {
+					goto bail;
+				}
+				break;
+			default:
+				literal[literal_length++] = c;
+				n++;
+				break;
+		}
 	}
+	if (!literal_length || ((prefix || suffix) && (options & UREGEX_MULTILINE))) goto bail;
 	
-	uregex_setText(regex_struct->uregexp, uchars, (int32_t)length, status);
-	if (U_ZERO_ERROR != *status) goto bail;
+	Boolean caseless = false;
+	if (options & UREGEX_CASE_INSENSITIVE) {
+		for (CFIndex k = 0; k < literal_length; k++) {
+			if (literal[k] >= 0x80) goto bail; // full case folding is left to ICU.
+			if (IsASCIILetter(literal[k])) {
+				literal[k] |= 0x20;
+				caseless = true;
+			}
+		}
+	}
+	regexp_struct->literalKind = prefix ? (suffix ? kTXRegexWholeLiteral : kTXRegexPrefixLiteral)
+										: (suffix ? kTXRegexSuffixLiteral : kTXRegexLiteral);
+	regexp_struct->patternLiteral = literal;
+	regexp_struct->patternLiteralLength = literal_length;
+	regexp_struct->literalCaseless = caseless;
+	regexp_struct->unixLines = (options & UREGEX_UNIX_LINES) != 0;
+	return;
+bail:
+	free(literal);
+}
+
+static Boolean UniCharsHaveCaselessLiteralAt(const UniChar *uchars, CFIndex index,
+											 const UniChar *literal, CFIndex literalLength)
+{
+	for (CFIndex k = 0; k < literalLength; k++) {
+		UniChar c = uchars[index + k];
+		if (IsASCIILetter(c)) c |= 0x20;
+		if (c != literal[k]) return false;
+	}
+	return true;
+}
+
+// Same as TXRegexFindLiteral for a lowercased literal matching ASCII letters of both cases.
+static CFIndex TXRegexFindCaselessLiteral(const UniChar *uchars, CFIndex length, CFIndex start,
+										  const UniChar *literal, CFIndex literalLength)
+{
+	CFIndex last = length - literalLength;
+	CFIndex n = start;
+	UniChar first_char = literal[0];
+	UniChar first_fold = IsASCIILetter(first_char) ? 0x20 : 0;
+#if defined(__SSE2__)
+	// setting 0x20 also hits some non-letters, which are rejected by the comparison.
+	const __m128i first_block = _mm_set1_epi16((short)first_char);
+	const __m128i fold_block = _mm_set1_epi16((short)first_fold);
+	for (; n + 8 <= last + 1; n += 8) {
+		__m128i block = _mm_or_si128(_mm_loadu_si128((const __m128i *)(uchars + n)), fold_block);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(block, first_block));
+		while (mask) {
+			CFIndex candidate = n + __builtin_ctz(mask) / 2;
+			if (UniCharsHaveCaselessLiteralAt(uchars, candidate, literal, literalLength)) return candidate;
+			mask &= mask - 1;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; n <= last; n++) {
+		if (((uchars[n] | first_fold) == first_char)
+			&& UniCharsHaveCaselessLiteralAt(uchars, n, literal, literalLength)) return n;
+	}
+	return kCFNotFound;
+}
+
+static Boolean TXRegexPatternLiteralIsAt(TXRegexStruct *regexp_struct, const UniChar *uchars, CFIndex index)
+{
+	if (regexp_struct->literalCaseless) {
+		return UniCharsHaveCaselessLiteralAt(uchars, index, regexp_struct->patternLiteral,
+											 regexp_struct->patternLiteralLength);
+	}
+	return !memcmp(uchars + index, regexp_struct->patternLiteral, regexp_struct->patternLiteralLength * sizeof(UniChar));
+}
+
+/*
+ Whether a literal pattern can be searched without ICU in a target. A caseless literal needs
+ a target of ASCII characters, because ICU folds some other characters into ASCII letters.
+ */
+static Boolean TXRegexCanMatchPatternLiteral(TXRegexStruct *regexp_struct, const UniChar *uchars, CFIndex length)
+{
+	if (kTXRegexNotLiteral == regexp_struct->literalKind) return false;
+	if (!regexp_struct->literalCaseless) return true;
+	for (CFIndex n = 0; n < length; n++) {
+		if (uchars[n] >= 0x80) return false;
+	}
+	return true;
+}
+
+static Boolean IsLineTerminator(UniChar c)
+{
+	return ((0x0A <= c) && (c <= 0x0D)) || (0x85 == c) || (0x2028 == c) || (0x2029 == c);
+}
+
+/*
+ Find the leftmost match of a literal pattern at or after start, same as ICU. $ matches at the end
+ of the target and before a line terminator at the end, where CR LF is one terminator.
+ */
+static CFIndex TXRegexFindPatternLiteral(TXRegexStruct *regexp_struct, const UniChar *uchars, CFIndex length,
+										 CFIndex start)
+{
+	CFIndex literal_length = regexp_struct->patternLiteralLength;
+	TXRegexLiteralKind kind = regexp_struct->literalKind;
+	if (kTXRegexLiteral == kind) {
+		if (regexp_struct->literalCaseless) {
+			return TXRegexFindCaselessLiteral(uchars, length, start, regexp_struct->patternLiteral, literal_length);
+		}
+		return TXRegexFindLiteral(uchars, length, start, regexp_struct->patternLiteral, literal_length);
+	}
+	if (kTXRegexPrefixLiteral == kind) {
+		return (0 == start) && (literal_length <= length) && TXRegexPatternLiteralIsAt(regexp_struct, uchars, 0) ?
+				0 : kCFNotFound;
+	}
+	// candidates of the end of a match in ascending order.
+	CFIndex ends[3];
+	int end_count = 0;
+	if (regexp_struct->unixLines) {
+		if ((length >= 1) && ('\n' == uchars[length-1])) ends[end_count++] = length-1;
+	} else {
+		Boolean ends_with_crlf = (length >= 2) && ('\r' == uchars[length-2]) && ('\n' == uchars[length-1]);
+		if (ends_with_crlf) ends[end_count++] = length-2;
+		else if ((length >= 1) && IsLineTerminator(uchars[length-1])) ends[end_count++] = length-1;
+	}
+	ends[end_count++] = length;
+	for (int k = 0; k < end_count; k++) {
+		CFIndex location = ends[k] - literal_length;
+		if ((kTXRegexWholeLiteral == kind) && (0 != location)) continue;
+		if ((location >= start) && TXRegexPatternLiteralIsAt(regexp_struct, uchars, location)) return location;
+	}
+	return kCFNotFound;
+}
+
+#pragma mark result cache
+
+typedef struct TXRegexResultEntry {
+	CFStringRef text; // a copy of the string to verify a hit.
+	CFHashCode hash;
+	CFIndex startIndex; // kCFNotFound for a result of CFStringIsMatchedWithRegex.
+	Boolean matched;
+	int32_t groupCount;
+	struct TXRegexResultEntry *chain; // next entry in the same bucket
+	struct TXRegexResultEntry *newer;
+	struct TXRegexResultEntry *older;
+	int32_t offsets[]; // start and end of each group of a first match.
+} TXRegexResultEntry;
+
+struct TXRegexResultCache {
+	TXRegexResultEntry **buckets;
+	CFIndex bucketCount;
+	TXRegexResultEntry *newest;
+	TXRegexResultEntry *oldest;
+	TXRegexCacheStatistics statistics;
+};
+
+#define kTXRegexHashBlockLength 256
+
+static uint64_t TXRegexHashUniChars(uint64_t hash, const UniChar *uchars, CFIndex length)
+{
+	CFIndex n = 0;
+	// four characters at a time.
+	for (; n + 4 <= length; n += 4) {
+		uint64_t word;
+		memcpy(&word, uchars + n, sizeof(word));
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 32;
+	}
+	for (; n < length; n++) hash = (hash ^ uchars[n]) * 0x9E3779B97F4A7C15ULL;
+	return hash;
+}
+
+// a hash of all characters of text, unlike CFHash which may look at only a part of a long string.
+static CFHashCode TXRegexHashString(CFStringRef text, CFIndex startIndex)
+{
+	CFIndex length = CFStringGetLength(text);
+	uint64_t hash = ((uint64_t)length * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)startIndex;
+	const UniChar *uchars = CFStringGetCharactersPtr(text);
+	UniChar buffer[kTXRegexHashBlockLength];
+	for (CFIndex location = 0; location < length; location += kTXRegexHashBlockLength) {
+		CFIndex count = (length - location < kTXRegexHashBlockLength) ? length - location : kTXRegexHashBlockLength;
+		if (uchars) {
+			hash = TXRegexHashUniChars(hash, uchars + location, count);
+		} else {
+			CFStringGetCharacters(text, CFRangeMake(location, count), buffer);
+			hash = TXRegexHashUniChars(hash, buffer, count);
+		}
+	}
+	return (CFHashCode)(hash ^ (hash >> 29));
+}
+
+static TXRegexResultEntry **TXRegexResultCacheBucket(struct TXRegexResultCache *cache, CFHashCode hash)
+{
+	return &cache->buckets[hash & (cache->bucketCount - 1)];
+}
+
+static void TXRegexResultCacheUnlinkEntry(struct TXRegexResultCache *cache, TXRegexResultEntry *entry)
+{
+	TXRegexResultEntry **link = TXRegexResultCacheBucket(cache, entry->hash);
+	while (*link != entry) link = &(*link)->chain;
+	*link = entry->chain;
 	
-	regex_struct->targetString = text_retained;
+	if (entry->newer) entry->newer->older = entry->older;
+	else cache->newest = entry->older;
+	if (entry->older) entry->older->newer = entry->newer;
+	else cache->oldest = entry->newer;
+	cache->statistics.count--;
+}
 
-	return length;
-bail:
-	SafeRelease(text_retained);
-	return 0;
+static void TXRegexResultCacheFreeEntry(TXRegexResultEntry *entry)
+{
+	CFRelease(entry->text);
+	free(entry);
+}
+
+static void TXRegexResultCacheMakeNewest(struct TXRegexResultCache *cache, TXRegexResultEntry *entry)
+{
+	if (cache->newest == entry) return;
+	// unlink from the LRU list
+	entry->newer->older = entry->older;
+	if (entry->older) entry->older->newer = entry->newer;
+	else cache->oldest = entry->newer;
+	// push to the newest end
+	entry->older = cache->newest;
+	entry->newer = NULL;
+	cache->newest->newer = entry;
+	cache->newest = entry;
+}
+
+static Boolean TXRegexResultCacheRehash(struct TXRegexResultCache *cache, CFIndex capacity)
+{
+	CFIndex bucket_count = 16;
+	while (bucket_count < capacity) bucket_count <<= 1;
+	if (bucket_count == cache->bucketCount) return true;
+	TXRegexResultEntry **buckets = calloc(bucket_count, sizeof(TXRegexResultEntry *));
+	if (!buckets) return false;
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->bucketCount = bucket_count;
+	for (TXRegexResultEntry *entry = cache->newest; entry; entry = entry->older) {
+		TXRegexResultEntry **bucket = TXRegexResultCacheBucket(cache, entry->hash);
+		entry->chain = *bucket;
+		*bucket = entry;
+	}
+	return true;
+}
+
+static void TXRegexResultCacheTrim(struct TXRegexResultCache *cache, CFIndex capacity)
+{
+	while (cache->statistics.count > capacity) {
+		TXRegexResultEntry *entry = cache->oldest;
+		TXRegexResultCacheUnlinkEntry(cache, entry);
+		TXRegexResultCacheFreeEntry(entry);
+		cache->statistics.evictions++;
+	}
+}
+
+static void TXRegexResultCacheFree(struct TXRegexResultCache *cache)
+{
+	if (!cache) return;
+	TXRegexResultCacheTrim(cache, 0);
+	free(cache->buckets);
+	free(cache);
+}
+
+static Boolean TXRegexResultCacheIsUsable(TXRegexStruct *regexp_struct, CFStringRef text)
+{
+	return regexp_struct->resultCache && (kCFNotFound == regexp_struct->region.location)
+			&& (CFStringGetLength(text) <= kTXRegexResultCacheMaxTextLength);
+}
+
+// a hit is moved to the newest end. hits and misses are counted.
+static TXRegexResultEntry *TXRegexResultCacheLookup(struct TXRegexResultCache *cache, CFStringRef text,
+													CFIndex startIndex, CFHashCode hash)
+{
+	for (TXRegexResultEntry *entry = *TXRegexResultCacheBucket(cache, hash); entry; entry = entry->chain) {
+		if ((entry->hash == hash) && (entry->startIndex == startIndex) && CFEqual(entry->text, text)) {
+			cache->statistics.hits++;
+			TXRegexResultCacheMakeNewest(cache, entry);
+			return entry;
+		}
+	}
+	cache->statistics.misses++;
+	return NULL;
 }
+
 /*
-static void TXRegexFree(TXRegexStruct *regexp)
+ Keep the result of a search of text. The groups of a first match are read from the matcher,
+ which must be left at the match.
+ */
+static void TXRegexResultCacheAdd(TXRegexStruct *regexp_struct, CFStringRef text, CFIndex startIndex,
+								  CFHashCode hash, Boolean matched)
+{
+	struct TXRegexResultCache *cache = regexp_struct->resultCache;
+	URegularExpression *re = regexp_struct->uregexp;
+	UErrorCode status = U_ZERO_ERROR;
+	int32_t gcount = 0;
+	if (matched && (kCFNotFound != startIndex)) {
+		gcount = uregex_groupCount(re, &status) + 1;
+		if (U_ZERO_ERROR != status) return;
+	}
+	TXRegexResultEntry *entry = malloc(sizeof(TXRegexResultEntry) + gcount * 2 * sizeof(int32_t));
+	if (!entry) return; // not cached.
+	for (int32_t n = 0; n < gcount; n++) {
+		entry->offsets[2*n] = uregex_start(re, n, &status);
+		entry->offsets[2*n+1] = uregex_end(re, n, &status);
+	}
+	if (U_ZERO_ERROR != status) {
+		free(entry);
+		return;
+	}
+	entry->text = CFStringCreateCopy(kCFAllocatorDefault, text);
+	entry->hash = hash;
+	entry->startIndex = startIndex;
+	entry->matched = matched;
+	entry->groupCount = gcount;
+	TXRegexResultEntry **bucket = TXRegexResultCacheBucket(cache, hash);
+	entry->chain = *bucket;
+	*bucket = entry;
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest) cache->newest->newer = entry;
+	else cache->oldest = entry;
+	cache->newest = entry;
+	cache->statistics.count++;
+	TXRegexResultCacheTrim(cache, cache->statistics.capacity);
+}
+
+// same as CFArrayCreateWithCapturedGroups for the first match kept by entry.
+static CFArrayRef TXRegexResultEntryCreateGroups(CFAllocatorRef allocator, TXRegexResultEntry *entry, CFStringRef text)
+{
+	CFMutableArrayRef result = CFArrayCreateMutable(allocator, entry->groupCount, &kCFTypeArrayCallBacks);
+	for (int32_t n = 0; n < entry->groupCount; n++) {
+		int32_t start = entry->offsets[2*n];
+		int32_t end = entry->offsets[2*n+1];
+		CFStringRef group_text = (-1 == start) ? CFRetain(CFSTR(""))
+								: CFStringCreateWithSubstring(allocator, text, CFRangeMake(start, end - start));
+		CFArrayAppendValue(result, group_text);
+		CFRelease(group_text);
+	}
+	return result;
+}
+
+static void TXRegexResultCacheSetCapacity(TXRegexStruct *regexp_struct, CFIndex capacity, UErrorCode *status)
+{
+	if (capacity <= 0) {
+		TXRegexResultCacheFree(regexp_struct->resultCache);
+		regexp_struct->resultCache = NULL;
+		return;
+	}
+	if (!regexp_struct->resultCache) {
+		regexp_struct->resultCache = calloc(1, sizeof(struct TXRegexResultCache));
+		if (!regexp_struct->resultCache) {
+			*status = U_MEMORY_ALLOCATION_ERROR;
+			return;
+		}
+	}
+	struct TXRegexResultCache *cache = regexp_struct->resultCache;
+	TXRegexResultCacheTrim(cache, capacity);
+	if (!TXRegexResultCacheRehash(cache, capacity)) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return;
+	}
+	cache->statistics.capacity = capacity;
+}
+
+void TXRegexSetResultCacheCapacity(TXRegexRef regexp, CFIndex capacity, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	TXRegexResultCacheSetCapacity(regexp_struct, capacity, status);
+}
+
+void TXRegexGetResultCacheStatistics(TXRegexRef regexp, TXRegexCacheStatistics *statistics)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (regexp_struct->resultCache) {
+		*statistics = regexp_struct->resultCache->statistics;
+	} else {
+		memset(statistics, 0, sizeof(TXRegexCacheStatistics));
+	}
+}
+
+#pragma mark Regex functions
+
+static void TXRegexReleaseTargetScratch(TXRegexStruct *regexp_struct)
+{
+	free(regexp_struct->targetScratch);
+	regexp_struct->targetScratch = NULL;
+	regexp_struct->targetScratchCapacity = 0;
+}
+
+/*!
+ @function TXRegexGetTargetBuffer
+ @abstract Return a buffer of the matcher which can hold length UTF-16 characters.
+ @discussion Short strings use the buffer inside TXRegexStruct. Longer strings use targetScratch, which grows geometrically and is kept across TXRegexSetString calls.
+ @result NULL when allocation fails.
+*/
+static UniChar *TXRegexGetTargetBuffer(TXRegexStruct *regexp_struct, CFIndex length)
+{
+	if (length <= kTXRegexInlineTargetLength) return regexp_struct->inlineTarget;
+	if (length > regexp_struct->targetScratchCapacity) {
+		CFIndex capacity = regexp_struct->targetScratchCapacity * 2;
+		if (capacity < length) capacity = length;
+		UniChar *buffer = realloc(regexp_struct->targetScratch, capacity * sizeof(UniChar));
+		if (!buffer) return NULL;
+		regexp_struct->targetScratch = buffer;
+		regexp_struct->targetScratchCapacity = capacity;
+	}
+	return regexp_struct->targetScratch;
+}
+
+CFIndex TXRegexSetString(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+{
+	TXRegexStruct* regex_struct = TXRegexGetStruct(regexp);
+	if (regex_struct->targetString) {
+#if useLog
+		fputs("before uregex_reset\n", stderr);
+#endif		
+		uregex_reset(regex_struct->uregexp, 0, status);
+		if (U_ZERO_ERROR != *status) return 0;
+		CFRelease(regex_struct->targetString);
+		regex_struct->targetString = NULL;
+	}
+	
+	CFIndex length = CFStringGetLength(text);
+	UniChar *uchars = (UniChar *)CFStringGetCharactersPtr(text);
+	Boolean copied = (NULL == uchars);
+	if (copied) {
+		// the previous target may point to the buffer which is about to be overwritten.
+		static const UChar empty[] = {0};
+		uregex_setText(regex_struct->uregexp, empty, 0, status);
+		if (U_ZERO_ERROR != *status) return 0;
+		uchars = TXRegexGetTargetBuffer(regex_struct, length);
+		if (!uchars) {
+			*status = U_MEMORY_ALLOCATION_ERROR;
+			return 0;
+		}
+		CFStringGetCharacters(text, CFRangeMake(0L, length), uchars);
+	}
+	
+	uregex_setText(regex_struct->uregexp, uchars, (int32_t)length, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	
+	regex_struct->targetString = CFRetain(text);
+	regex_struct->targetCopied = copied;
+	regex_struct->searchStart = 0;
+	if (copied && TXRegexStatisticsIsEnabled()) {
+		TXRegexStatisticsAdd(regex_struct, copiedTargets, 1);
+		TXRegexStatisticsAdd(regex_struct, copiedBytes, length * sizeof(UniChar));
+	}
+	if (regex_struct->targetBytes) {
+		CFRelease(regex_struct->targetBytes);
+		regex_struct->targetBytes = NULL;
+	}
+	TXRegexApplyRegion(regex_struct, length, status);
+	if (U_ZERO_ERROR != *status) return 0;
+
+	return length;
+}
+CFIndex TXRegexSetUTF8Bytes(TXRegexRef regexp, CFDataRef bytes, UErrorCode *status)
+{
+	TXRegexStruct *regex_struct = TXRegexGetStruct(regexp);
+	CFIndex length = CFDataGetLength(bytes);
+	UText *utext = utext_openUTF8(NULL, (const char *)CFDataGetBytePtr(bytes), length, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	uregex_setUText(regex_struct->uregexp, utext, status); // ICU keeps a shallow clone of utext.
+	utext_close(utext);
+	if (U_ZERO_ERROR != *status) return 0;
+	
+	CFRetain(bytes);
+	SafeRelease(regex_struct->targetBytes);
+	regex_struct->targetBytes = bytes;
+	SafeRelease(regex_struct->targetString);
+	regex_struct->targetString = NULL;
+	regex_struct->anchorByteOffset = 0;
+	regex_struct->anchorUTF16Offset = 0;
+	TXRegexApplyRegion(regex_struct, length, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	return length;
+}
+
+static void MappedFileDeallocate(void *ptr, void *info)
+{
+	munmap(ptr, (size_t)info);
+}
+
+static CFAllocatorRef CreateMappedFileDeallocator(size_t size)
+{
+	CFAllocatorContext context =
+	{0, // version
+		(void *)size, // info
+		NULL, // retain callback
+		NULL, // CFAllocatorReleaseCallBack
+		NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, // CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack
+		MappedFileDeallocate, // CFAllocatorDeallocateCallBack
+		NULL // CFAllocatorPreferredSizeCallBack
+	};
+	return CFAllocatorCreate(NULL, &context);
+}
+
+CFIndex TXRegexSetFile(TXRegexRef regexp, const char *path, UErrorCode *status)
+{
+	CFDataRef bytes = NULL;
+	CFIndex length = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		*status = U_FILE_ACCESS_ERROR;
+		return 0;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) < 0) {
+		*status = U_FILE_ACCESS_ERROR;
+		goto bail;
+	}
+	if (0 == file_stat.st_size) {
+		bytes = CFDataCreate(kCFAllocatorDefault, NULL, 0);
+	} else {
+		void *mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED == mapped) {
+			*status = U_FILE_ACCESS_ERROR;
+			goto bail;
+		}
+		madvise(mapped, file_stat.st_size, MADV_SEQUENTIAL);
+		CFAllocatorRef deallocator = CreateMappedFileDeallocator(file_stat.st_size);
+		bytes = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault, mapped, file_stat.st_size, deallocator);
+		CFRelease(deallocator);
+	}
+	length = TXRegexSetUTF8Bytes(regexp, bytes, status);
+bail:
+	close(fd);
+	SafeRelease(bytes);
+	return length;
+}
+
+void TXRegexSetOffsetUnit(TXRegexRef regexp, TXRegexOffsetUnit unit)
+{
+	TXRegexStruct *regex_struct = TXRegexGetStruct(regexp);
+	regex_struct->offsetUnit = unit;
+}
+
+void TXRegexSetGroupMode(TXRegexRef regexp, TXRegexGroupMode mode)
+{
+	TXRegexStruct *regex_struct = TXRegexGetStruct(regexp);
+	regex_struct->groupMode = mode;
+}
+
+void TXRegexSetResultAllocator(TXRegexRef regexp, CFAllocatorRef allocator)
+{
+	TXRegexStruct *regex_struct = TXRegexGetStruct(regexp);
+	if (allocator) CFRetain(allocator);
+	SafeRelease(regex_struct->resultAllocator);
+	regex_struct->resultAllocator = allocator;
+}
+
+static UBool TXRegexCallMatchCallback(const void *context, int32_t steps)
+{
+	const TXRegexStruct *regexp_struct = (const TXRegexStruct *)context;
+	return regexp_struct->matchCallback(steps, regexp_struct->matchCallbackInfo);
+}
+
+/*
+ Apply the limits of regexp_struct to uregexp, a clone of regexp_struct->uregexp or the original.
+ ICU does not copy the limits into clones. The callback context is regexp_struct, which must outlive uregexp.
+ */
+static void TXRegexApplyLimits(const TXRegexStruct *regexp_struct, URegularExpression *uregexp, UErrorCode *status)
+{
+	uregex_setTimeLimit(uregexp, regexp_struct->timeLimit, status);
+	uregex_setStackLimit(uregexp, regexp_struct->stackLimit, status);
+	uregex_setMatchCallback(uregexp, regexp_struct->matchCallback ? TXRegexCallMatchCallback : NULL,
+							regexp_struct, status);
+}
+
+void TXRegexSetTimeLimit(TXRegexRef regexp, int32_t limit, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	uregex_setTimeLimit(regexp_struct->uregexp, limit, status);
+	if (U_ZERO_ERROR == *status) regexp_struct->timeLimit = limit;
+}
+
+void TXRegexSetStackLimit(TXRegexRef regexp, int32_t limit, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	uregex_setStackLimit(regexp_struct->uregexp, limit, status);
+	if (U_ZERO_ERROR == *status) regexp_struct->stackLimit = limit;
+}
+
+void TXRegexSetMatchCallback(TXRegexRef regexp, TXRegexMatchCallback callback, void *info, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	uregex_setMatchCallback(regexp_struct->uregexp, callback ? TXRegexCallMatchCallback : NULL, regexp_struct, status);
+	if (U_ZERO_ERROR != *status) return;
+	regexp_struct->matchCallback = callback;
+	regexp_struct->matchCallbackInfo = info;
+}
+
+void TXRegexSetRegion(TXRegexRef regexp, CFRange range, Boolean transparentBounds, Boolean anchoringBounds,
+					  UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if ((kCFNotFound != range.location) && ((range.location < 0) || (range.length < 0))) {
+		*status = U_ILLEGAL_ARGUMENT_ERROR;
+		return;
+	}
+	regexp_struct->region = range;
+	regexp_struct->regionTransparentBounds = transparentBounds;
+	regexp_struct->regionAnchoringBounds = anchoringBounds;
+	int64_t length = 0;
+	if (regexp_struct->targetBytes) {
+		length = CFDataGetLength(regexp_struct->targetBytes);
+	} else if (regexp_struct->targetString) {
+		int32_t text_length = 0;
+		uregex_getText(regexp_struct->uregexp, &text_length, status);
+		if (U_ZERO_ERROR != *status) return;
+		length = text_length;
+	} else {
+		return; // applied when a target is set.
+	}
+	TXRegexApplyRegion(regexp_struct, length, status);
+	regexp_struct->searchStart = 0;
+}
+
+static void TXRegexResetTarget(TXRegexStruct *regexp_struct)
+{
+	static const UChar empty[] = {0};
+	if (!regexp_struct->targetString && !regexp_struct->targetBytes) return;
+	UErrorCode status = U_ZERO_ERROR;
+	uregex_setText(regexp_struct->uregexp, empty, 0, &status);
+	SafeRelease(regexp_struct->targetString);
+	regexp_struct->targetString = NULL;
+	SafeRelease(regexp_struct->targetBytes);
+	regexp_struct->targetBytes = NULL;
+	regexp_struct->regionStart = -1;
+	regexp_struct->regionLimit = -1;
+	// a pooled matcher should not hold the buffer of an exceptionally long target.
+	if (regexp_struct->targetScratchCapacity > kTXRegexTargetScratchKeepLength) {
+		TXRegexReleaseTargetScratch(regexp_struct);
+	}
+}
+
+/*
+static void TXRegexFree(TXRegexStruct *regexp)
+{
+	if (!regexp) return;
+	uregex_close(regexp->uregexp);
+	SafeRelease(regexp->targetString);
+	free(regexp);
+}
+*/
+
+static void TXRegexDeallocate(void *ptr, void *info)
+{
+#if useLog
+	fputs("TXRegexDeallocate\n", stderr);
+#endif		
+	TXRegexStruct *regexp = (TXRegexStruct *)ptr;
+	uregex_close(regexp->uregexp);
+	SafeRelease(regexp->targetString);
+	SafeRelease(regexp->targetBytes);
+	SafeRelease(regexp->requiredLiteral);
+	TXRegexReleaseTargetScratch(regexp);
+	free(regexp->patternLiteral);
+	TXRegexResultCacheFree(regexp->resultCache);
+	TXRegexStatisticsBlockRelease(regexp->statistics);
+	SafeRelease(regexp->resultAllocator);
+	free(regexp);
+}
+
+char *austrdup(const UChar* unichars)
+
+{
+    int   length;
+    char *newString;
+	
+    length    = u_strlen ( unichars );
+    newString = (char*)malloc ( sizeof( char ) * 4 * ( length + 1 ) );
+    if ( newString == NULL )
+        return NULL;
+	
+    u_austrcpy ( newString, unichars );
+	
+    return newString;
+}
+
+void fprintParseError(FILE *stream, UParseError *parse_error)
+{
+	char *post_context = austrdup(parse_error->postContext);
+	char *pre_context = austrdup(parse_error->preContext);
+	fprintf(stream ,"line : %d, offset : %d, precontext : %s, postcontext : %s\n",
+			parse_error->line, parse_error->offset, pre_context, post_context);
+	free(post_context);
+	free(pre_context);
+}
+
+CFStringRef CFStringCreateWithFormattingParseError(UParseError *parse_error)
+{
+    char *post_context = austrdup(parse_error->postContext);
+	char *pre_context = austrdup(parse_error->preContext);
+    CFStringRef result = CFStringCreateWithFormat(kCFAllocatorDefault, NULL,
+								CFSTR("line : %d, offset : %d, precontext : %s, postcontext : %s\n"),
+								parse_error->line, parse_error->offset, pre_context, post_context);
+    free(post_context);
+	free(pre_context);
+    return result;
+}
+
+static CFAllocatorRef CreateTXRegexDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+static void TXRegexSetRequiredLiteral(TXRegexStruct *regexp_struct, CFStringRef literal, Boolean isPrefix)
+{
+	SafeRelease(regexp_struct->requiredLiteral);
+	regexp_struct->requiredLiteral = NULL;
+	regexp_struct->literalLength = 0;
+	if (!literal) return;
+	UniChar *uchars = NULL;
+	CFIndex length = 0;
+	regexp_struct->requiredLiteral = CFStringRetainAndGetUTF16Ptr(literal, &uchars, &length);
+	if (!regexp_struct->requiredLiteral) return;
+	regexp_struct->literalChars = uchars;
+	regexp_struct->literalLength = length;
+	regexp_struct->literalIsPrefix = isPrefix;
+}
+
+static Boolean TXRegexAllocatorIsArena(CFAllocatorRef allocator); // defined with the arena allocator.
+
+/*
+ The object is never allocated from an arena, since it must survive TXRegexArenaReset.
+ The arena is used only for the results.
+ */
+static TXRegexRef TXRegexCreateWithURegularExpression(CFAllocatorRef allocator, URegularExpression *uregexp)
+{
+	TXRegexStruct *regexp_struct = malloc(sizeof(TXRegexStruct));
+	TXRegexStatisticsBlock *statistics = TXRegexStatisticsBlockCreate();
+	if (!regexp_struct || !statistics) {
+		uregex_close(uregexp);
+		free(regexp_struct);
+		free(statistics);
+		return NULL;
+	}
+	regexp_struct->uregexp = uregexp;
+	regexp_struct->targetString = NULL;
+	regexp_struct->targetBytes = NULL;
+	regexp_struct->offsetUnit = kTXRegexOffsetUTF16;
+	regexp_struct->groupMode = kTXRegexGroupCopy;
+	regexp_struct->anchorByteOffset = 0;
+	regexp_struct->anchorUTF16Offset = 0;
+	regexp_struct->requiredLiteral = NULL;
+	regexp_struct->literalChars = NULL;
+	regexp_struct->literalLength = 0;
+	regexp_struct->literalIsPrefix = false;
+	regexp_struct->searchStart = -1;
+	regexp_struct->statistics = statistics;
+	regexp_struct->targetCopied = false;
+	regexp_struct->targetScratch = NULL;
+	regexp_struct->targetScratchCapacity = 0;
+	regexp_struct->literalKind = kTXRegexNotLiteral;
+	regexp_struct->patternLiteral = NULL;
+	regexp_struct->patternLiteralLength = 0;
+	regexp_struct->literalCaseless = false;
+	regexp_struct->unixLines = false;
+	regexp_struct->timeLimit = 0;
+	regexp_struct->stackLimit = kTXRegexDefaultStackLimit;
+	regexp_struct->matchCallback = NULL;
+	regexp_struct->matchCallbackInfo = NULL;
+	regexp_struct->region = CFRangeMake(kCFNotFound, 0);
+	regexp_struct->regionTransparentBounds = false;
+	regexp_struct->regionAnchoringBounds = true;
+	regexp_struct->regionStart = -1;
+	regexp_struct->regionLimit = -1;
+	regexp_struct->resultCache = NULL;
+	regexp_struct->resultAllocator = allocator ? CFRetain(allocator) : NULL;
+	if (uregexp) {
+		UErrorCode status = U_ZERO_ERROR;
+		int32_t pattern_length = 0;
+		const UChar *pattern = uregex_pattern(uregexp, &pattern_length, &status);
+		uint32_t options = uregex_flags(uregexp, &status);
+		if (U_ZERO_ERROR == status) {
+			TXRegexAnalyzeLiteralPattern(regexp_struct, pattern, pattern_length, options);
+		}
+	}
+	CFAllocatorRef deallocator = CreateTXRegexDeallocator();
+	CFAllocatorRef object_allocator = TXRegexAllocatorIsArena(allocator) ? kCFAllocatorDefault : allocator;
+	return CFDataCreateWithBytesNoCopy(object_allocator, (const UInt8 *)regexp_struct, 
+									   sizeof(TXRegexStruct), deallocator);
+}
+
+TXRegexRef TXRegexCreate(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status)
+{
+	UniChar *uchars = NULL;
+	CFIndex length;
+	CFStringRef pattern_retained = CFStringRetainAndGetUTF16Ptr(pattern, &uchars, &length);
+	if (!pattern_retained) return NULL;
+	
+	uint64_t start_time = TXRegexNanoseconds();
+	URegularExpression *uregexp = uregex_open(uchars, (int32_t)length, options, parse_error, status);
+	
+	CFRelease(pattern_retained);
+	TXRegexRef regexp = TXRegexCreateWithURegularExpression(allocator, uregexp);
+	if (regexp && (U_ZERO_ERROR == *status)) {
+		Boolean is_prefix = false;
+		CFStringRef literal = CFStringCreateWithRequiredLiteral(pattern, options, &is_prefix);
+		TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+		TXRegexSetRequiredLiteral(regexp_struct, literal, is_prefix);
+		TXRegexStatisticsSetCompileTime(regexp_struct, start_time);
+		SafeRelease(literal);
+	}
+	return regexp;
+}
+
+void TXRegexSetStatisticsEnabled(Boolean enabled)
+{
+	__atomic_store_n(&TXRegexStatisticsEnabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void TXRegexGetStatistics(TXRegexRef regexp, TXRegexStatistics *statistics)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	CFIndex *fields = (CFIndex *)&regexp_struct->statistics->counters;
+	CFIndex *result = (CFIndex *)statistics;
+	for (size_t n = 0; n < sizeof(TXRegexStatistics)/sizeof(CFIndex); n++) {
+		result[n] = __atomic_load_n(&fields[n], __ATOMIC_RELAXED);
+	}
+}
+
+void TXRegexResetStatistics(TXRegexRef regexp)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	CFIndex *fields = (CFIndex *)&regexp_struct->statistics->counters;
+	for (size_t n = 0; n < sizeof(TXRegexStatistics)/sizeof(CFIndex); n++) {
+		__atomic_store_n(&fields[n], 0, __ATOMIC_RELAXED);
+	}
+}
+
+TXRegexRef TXRegexCreateCopy(CFAllocatorRef allocator, TXRegexRef regexp, UErrorCode *status)
+{
+#if useLog
+	fputs("TXRegexCreateCopy\n", stderr);
+#endif	
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	URegularExpression *new_uregexp = uregex_clone(regexp_struct->uregexp, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	
+	TXRegexRef new_regexp = TXRegexCreateWithURegularExpression(allocator, new_uregexp);
+	if (new_regexp) {
+		TXRegexStruct *new_struct = TXRegexGetStruct(new_regexp);
+		TXRegexSetRequiredLiteral(new_struct, regexp_struct->requiredLiteral, regexp_struct->literalIsPrefix);
+		TXRegexShareStatistics(new_struct, regexp_struct->statistics);
+		new_struct->offsetUnit = regexp_struct->offsetUnit;
+		new_struct->groupMode = regexp_struct->groupMode;
+		new_struct->timeLimit = regexp_struct->timeLimit;
+		new_struct->stackLimit = regexp_struct->stackLimit;
+		new_struct->matchCallback = regexp_struct->matchCallback;
+		new_struct->matchCallbackInfo = regexp_struct->matchCallbackInfo;
+		new_struct->region = regexp_struct->region;
+		new_struct->regionTransparentBounds = regexp_struct->regionTransparentBounds;
+		new_struct->regionAnchoringBounds = regexp_struct->regionAnchoringBounds;
+		TXRegexApplyLimits(new_struct, new_uregexp, status);
+		if (regexp_struct->resultCache) {
+			TXRegexSetResultCacheCapacity(new_regexp, regexp_struct->resultCache->statistics.capacity, status);
+		}
+		if (U_ZERO_ERROR != *status) {
+			CFRelease(new_regexp);
+			return NULL;
+		}
+	}
+	return new_regexp;
+}
+
+CFStringRef TXRegexCopyPatternString(TXRegexRef regexp, UErrorCode *status)
+{
+	int32_t len;
+	const UChar *uchars = NULL;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	uchars = uregex_pattern(regexp_struct->uregexp, &len, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	return CFStringCreateWithCharacters(kCFAllocatorDefault, uchars, len);
+}
+
+CFStringRef TXRegexCopyTargetString(TXRegexRef regexp, UErrorCode *status)
+{
+	int32_t len;
+	const UChar *uchars = NULL;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	uchars = uregex_getText(regexp_struct->uregexp, &len, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	return CFStringCreateWithCharacters(kCFAllocatorDefault, uchars, len);
+}
+
+CFArrayRef CFArrayCreateWithFirstMatch(TXRegexRef regexp, CFIndex startIndex, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFind(regexp_struct, startIndex, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	return CFArrayCreateWithCapturedGroups(regexp, status);
+}
+
+CFArrayRef CFArrayCreateWithNextMatch(TXRegexRef regexp, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFindNext(regexp_struct, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	return CFArrayCreateWithCapturedGroups(regexp, status);
+}
+
+CFArrayRef TXRegexFirstMatch(TXRegexRef regexp, CFIndex startIndex, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFind(regexp_struct, startIndex, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	return TXRegexCapturedGroups(regexp, status);
+}
+
+CFArrayRef TXRegexNextMatch(TXRegexRef regexp, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFindNext(regexp_struct, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	return TXRegexCapturedGroups(regexp, status);
+}
+
+static CFIndex TXRegexGetMatchRanges(TXRegexStruct *regexp_struct, CFRange *ranges, CFIndex capacity, UErrorCode *status)
+{
+	URegularExpression *re = regexp_struct->uregexp;
+	int32_t gcount = uregex_groupCount(re, status) + 1;
+	if (U_ZERO_ERROR != *status) return 0;
+	CFIndex n_ranges = (gcount < capacity) ? gcount : capacity;
+	for (CFIndex n = 0; n < n_ranges; n++) {
+		int64_t start = uregex_start64(re, (int32_t)n, status);
+		if (U_ZERO_ERROR != *status) return 0;
+		int64_t end = uregex_end64(re, (int32_t)n, status);
+		if (U_ZERO_ERROR != *status) return 0;
+		if (-1 == start) {
+			ranges[n] = CFRangeMake(kCFNotFound, 0);
+		} else {
+			start = TXRegexReportedOffset(regexp_struct, start);
+			end = TXRegexReportedOffset(regexp_struct, end);
+			ranges[n] = CFRangeMake(start, end-start);
+		}
+	}
+	return gcount;
+}
+
+CFIndex TXRegexGetGroupCount(TXRegexRef regexp, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	int32_t gcount = uregex_groupCount(regexp_struct->uregexp, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	return gcount + 1;
+}
+
+CFIndex TXRegexFirstMatchRanges(TXRegexRef regexp, CFIndex startIndex, CFRange *ranges, CFIndex capacity, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFind(regexp_struct, startIndex, status)) return 0;
+	if (U_ZERO_ERROR != *status) return 0;
+	return TXRegexGetMatchRanges(regexp_struct, ranges, capacity, status);
+}
+
+CFIndex TXRegexNextMatchRanges(TXRegexRef regexp, CFRange *ranges, CFIndex capacity, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexFindNext(regexp_struct, status)) return 0;
+	if (U_ZERO_ERROR != *status) return 0;
+	return TXRegexGetMatchRanges(regexp_struct, ranges, capacity, status);
+}
+
+CFStringRef TXRegexCopySubstring(TXRegexRef regexp, CFRange range, UErrorCode *status)
+{
+	if (kCFNotFound == range.location) return CFRetain(CFSTR(""));
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (regexp_struct->targetBytes) {
+		int64_t start = TXRegexNativeOffset(regexp_struct, range.location);
+		int64_t end = TXRegexNativeOffset(regexp_struct, range.location + range.length);
+		if (range.location < 0 || range.length < 0 || end > CFDataGetLength(regexp_struct->targetBytes)) {
+			*status = U_INDEX_OUTOFBOUNDS_ERROR;
+			return NULL;
+		}
+		return CFStringCreateWithBytes(regexp_struct->resultAllocator, CFDataGetBytePtr(regexp_struct->targetBytes) + start,
+									   end - start, kCFStringEncodingUTF8, false);
+	}
+	if (!regexp_struct->targetString) {
+		*status = U_REGEX_INVALID_STATE;
+		return NULL;
+	}
+	// a copied target is what was searched even if targetString is mutated afterwards.
+	int32_t length = 0;
+	const UniChar *uchars = NULL;
+	if (regexp_struct->targetCopied) {
+		uchars = uregex_getText(regexp_struct->uregexp, &length, status);
+		if (U_ZERO_ERROR != *status) return NULL;
+	} else {
+		length = (int32_t)CFStringGetLength(regexp_struct->targetString);
+	}
+	if (range.location < 0 || range.length < 0 || range.location + range.length > length) {
+		*status = U_INDEX_OUTOFBOUNDS_ERROR;
+		return NULL;
+	}
+	if (uchars) return CFStringCreateWithCharacters(regexp_struct->resultAllocator, uchars + range.location, range.length);
+	return CFStringCreateWithSubstring(regexp_struct->resultAllocator, regexp_struct->targetString, range);
+}
+
+CFArrayRef TXRegexFirstMatchInString(TXRegexRef regexp, CFStringRef text, CFIndex startIndex, UErrorCode *status)
+{
+	if (!TXRegexSetString(regexp, text, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	return TXRegexFirstMatch(regexp, startIndex, status);
+}
+
+CFArrayRef TXRegexAllMatchesInString(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+{
+	if (!TXRegexSetString(regexp, text, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	CFMutableArrayRef matches = NULL;
+	matches = CFArrayCreateMutable(regexp_struct->resultAllocator, 0, &kCFTypeArrayCallBacks);
+
+	CFArrayRef a_match = NULL;
+	while ((a_match = TXRegexNextMatch(regexp, status))) {
+		if(U_ZERO_ERROR != *status) {
+			CFRelease(a_match);
+			break;
+		}
+		CFArrayAppendValue(matches, a_match);
+		CFRelease(a_match);		
+	}
+	
+	return matches;
+}
+
+/*
+ Get the target when the pattern is a literal which can be searched without ICU.
+ Returns false when ICU has to search the target or when an error occurred.
+ */
+static Boolean TXRegexGetPatternLiteralTarget(TXRegexStruct *regexp_struct, const UniChar **uchars, int32_t *length,
+											  UErrorCode *status)
+{
+	if ((kTXRegexNotLiteral == regexp_struct->literalKind) || !regexp_struct->targetString) return false;
+	if (regexp_struct->regionStart >= 0) return false;
+	*uchars = uregex_getText(regexp_struct->uregexp, length, status);
+	if (U_ZERO_ERROR != *status) return false;
+	return TXRegexCanMatchPatternLiteral(regexp_struct, *uchars, *length);
+}
+
+Boolean TXRegexHasMatch(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+{
+	TXRegexSetString(regexp, text, status);
+	if (U_ZERO_ERROR != *status) return false;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	const UniChar *uchars = NULL;
+	int32_t length = 0;
+	if (TXRegexGetPatternLiteralTarget(regexp_struct, &uchars, &length, status)) {
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		Boolean found = (kCFNotFound != TXRegexFindPatternLiteral(regexp_struct, uchars, length, 0));
+		TXRegexStatisticsRecordSearch(regexp_struct, start_time, found, *status);
+		return found;
+	}
+	if (U_ZERO_ERROR != *status) return false;
+	UBool found = TXRegexFind(regexp_struct, 0, status);
+	return found && (U_ZERO_ERROR == *status);
+}
+
+CFIndex TXRegexCountMatches(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+{
+	TXRegexSetString(regexp, text, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	CFIndex count = 0;
+	const UniChar *uchars = NULL;
+	int32_t length = 0;
+	if (TXRegexGetPatternLiteralTarget(regexp_struct, &uchars, &length, status)) {
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		for (CFIndex found = TXRegexFindPatternLiteral(regexp_struct, uchars, length, 0); kCFNotFound != found;
+			 found = TXRegexFindPatternLiteral(regexp_struct, uchars, length,
+											   found + regexp_struct->patternLiteralLength)) {
+			count++;
+		}
+		TXRegexStatisticsRecordSearch(regexp_struct, start_time, count > 0, *status);
+		return count;
+	}
+	if (U_ZERO_ERROR != *status) return 0;
+	// only the search position is advanced, same as TXRegexAllMatchesInString.
+	for (UBool found = TXRegexFind(regexp_struct, 0, status); found && (U_ZERO_ERROR == *status);
+		 found = TXRegexFindNext(regexp_struct, status)) {
+		count++;
+	}
+	return (U_ZERO_ERROR == *status) ? count : 0;
+}
+
+#pragma mark compiled pattern cache
+
+typedef struct TXRegexCacheEntry {
+	CFStringRef pattern;
+	uint32_t options;
+	CFHashCode hash;
+	URegularExpression *uregexp;
+	CFStringRef literal; // the required literal of the pattern, or NULL
+	Boolean literalIsPrefix;
+	TXRegexStatisticsBlock *statistics; // shared with the regular expressions made from the entry.
+	struct TXRegexCacheEntry *chain; // next entry in the same bucket
+	struct TXRegexCacheEntry *newer;
+	struct TXRegexCacheEntry *older;
+} TXRegexCacheEntry;
+
+static struct {
+	pthread_mutex_t lock;
+	TXRegexCacheEntry **buckets;
+	CFIndex bucketCount;
+	TXRegexCacheEntry *newest;
+	TXRegexCacheEntry *oldest;
+	TXRegexCacheStatistics statistics;
+} TXRegexCache = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, NULL, NULL, {0, 0, 0, 0, 256}};
+
+static TXRegexCacheEntry **TXRegexCacheBucket(CFHashCode hash)
+{
+	return &TXRegexCache.buckets[hash & (TXRegexCache.bucketCount - 1)];
+}
+
+static void TXRegexCacheUnlinkEntry(TXRegexCacheEntry *entry)
+{
+	TXRegexCacheEntry **link = TXRegexCacheBucket(entry->hash);
+	while (*link != entry) link = &(*link)->chain;
+	*link = entry->chain;
+	
+	if (entry->newer) entry->newer->older = entry->older;
+	else TXRegexCache.newest = entry->older;
+	if (entry->older) entry->older->newer = entry->newer;
+	else TXRegexCache.oldest = entry->newer;
+	TXRegexCache.statistics.count--;
+}
+
+static void TXRegexCacheFreeEntry(TXRegexCacheEntry *entry)
+{
+	uregex_close(entry->uregexp);
+	CFRelease(entry->pattern);
+	SafeRelease(entry->literal);
+	TXRegexStatisticsBlockRelease(entry->statistics);
+	free(entry);
+}
+
+static void TXRegexCacheMakeNewest(TXRegexCacheEntry *entry)
+{
+	if (TXRegexCache.newest == entry) return;
+	// unlink from the LRU list
+	entry->newer->older = entry->older;
+	if (entry->older) entry->older->newer = entry->newer;
+	else TXRegexCache.oldest = entry->newer;
+	// push to the newest end
+	entry->older = TXRegexCache.newest;
+	entry->newer = NULL;
+	TXRegexCache.newest->newer = entry;
+	TXRegexCache.newest = entry;
+}
+
+static Boolean TXRegexCacheRehash(CFIndex capacity)
+{
+	CFIndex bucket_count = 16;
+	while (bucket_count < capacity) bucket_count <<= 1;
+	if (bucket_count == TXRegexCache.bucketCount) return true;
+	TXRegexCacheEntry **buckets = calloc(bucket_count, sizeof(TXRegexCacheEntry *));
+	if (!buckets) return false;
+	free(TXRegexCache.buckets);
+	TXRegexCache.buckets = buckets;
+	TXRegexCache.bucketCount = bucket_count;
+	for (TXRegexCacheEntry *entry = TXRegexCache.newest; entry; entry = entry->older) {
+		TXRegexCacheEntry **bucket = TXRegexCacheBucket(entry->hash);
+		entry->chain = *bucket;
+		*bucket = entry;
+	}
+	return true;
+}
+
+static void TXRegexCacheTrim(CFIndex capacity)
+{
+	while (TXRegexCache.statistics.count > capacity) {
+		TXRegexCacheEntry *entry = TXRegexCache.oldest;
+		TXRegexCacheUnlinkEntry(entry);
+		TXRegexCacheFreeEntry(entry);
+		TXRegexCache.statistics.evictions++;
+	}
+}
+
+static TXRegexCacheEntry *TXRegexCacheLookup(CFStringRef pattern, uint32_t options, CFHashCode hash)
+{
+	if (!TXRegexCache.buckets) return NULL;
+	for (TXRegexCacheEntry *entry = *TXRegexCacheBucket(hash); entry; entry = entry->chain) {
+		if ((entry->hash == hash) && (entry->options == options) && CFEqual(entry->pattern, pattern)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+TXRegexRef TXRegexCreateWithCache(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status)
+{
+	CFHashCode hash = CFHash(pattern) ^ ((CFHashCode)options * 0x9E3779B1);
+	URegularExpression *uregexp = NULL;
+	CFStringRef literal = NULL;
+	Boolean literal_is_prefix = false;
+	TXRegexStatisticsBlock *statistics = NULL;
+	TXRegexRef result = NULL;
+	
+	pthread_mutex_lock(&TXRegexCache.lock);
+	TXRegexCacheEntry *entry = TXRegexCacheLookup(pattern, options, hash);
+	if (entry) {
+		TXRegexCache.statistics.hits++;
+		TXRegexCacheMakeNewest(entry);
+		uregexp = uregex_clone(entry->uregexp, status);
+		if (entry->literal) literal = CFRetain(entry->literal);
+		literal_is_prefix = entry->literalIsPrefix;
+		statistics = TXRegexStatisticsBlockRetain(entry->statistics);
+	} else {
+		TXRegexCache.statistics.misses++;
+	}
+	pthread_mutex_unlock(&TXRegexCache.lock);
+	if (entry) {
+		if (U_ZERO_ERROR == *status) result = TXRegexCreateWithURegularExpression(allocator, uregexp);
+		if (result) {
+			TXRegexStruct *result_struct = TXRegexGetStruct(result);
+			TXRegexSetRequiredLiteral(result_struct, literal, literal_is_prefix);
+			TXRegexShareStatistics(result_struct, statistics);
+		}
+		SafeRelease(literal);
+		TXRegexStatisticsBlockRelease(statistics);
+		return result;
+	}
+	
+	// compile without holding the lock.
+	uint64_t start_time = TXRegexNanoseconds();
+	UniChar *uchars = NULL;
+	CFIndex length;
+	CFStringRef pattern_retained = CFStringRetainAndGetUTF16Ptr(pattern, &uchars, &length);
+	if (!pattern_retained) return NULL;
+	URegularExpression *compiled = uregex_open(uchars, (int32_t)length, options, parse_error, status);
+	CFRelease(pattern_retained);
+	if (U_ZERO_ERROR != *status) {
+		if (compiled) uregex_close(compiled);
+		return NULL;
+	}
+	
+	uregexp = uregex_clone(compiled, status);
+	if (U_ZERO_ERROR != *status) {
+		uregex_close(compiled);
+		return NULL;
+	}
+	literal = CFStringCreateWithRequiredLiteral(pattern, options, &literal_is_prefix);
+	result = TXRegexCreateWithURegularExpression(allocator, uregexp);
+	if (result) {
+		TXRegexStruct *result_struct = TXRegexGetStruct(result);
+		TXRegexSetRequiredLiteral(result_struct, literal, literal_is_prefix);
+		TXRegexStatisticsSetCompileTime(result_struct, start_time);
+		statistics = result_struct->statistics;
+	}
+	
+	pthread_mutex_lock(&TXRegexCache.lock);
+	if ((TXRegexCache.statistics.capacity > 0)
+		&& !TXRegexCacheLookup(pattern, options, hash) // another thread may have inserted it.
+		&& TXRegexCacheRehash(TXRegexCache.statistics.capacity)
+		&& (entry = malloc(sizeof(TXRegexCacheEntry)))) {
+		entry->pattern = CFStringCreateCopy(kCFAllocatorDefault, pattern);
+		entry->options = options;
+		entry->hash = hash;
+		entry->uregexp = compiled;
+		entry->literal = literal ? CFRetain(literal) : NULL;
+		entry->literalIsPrefix = literal_is_prefix;
+		entry->statistics = TXRegexStatisticsBlockRetain(statistics);
+		TXRegexCacheEntry **bucket = TXRegexCacheBucket(hash);
+		entry->chain = *bucket;
+		*bucket = entry;
+		entry->newer = NULL;
+		entry->older = TXRegexCache.newest;
+		if (TXRegexCache.newest) TXRegexCache.newest->newer = entry;
+		else TXRegexCache.oldest = entry;
+		TXRegexCache.newest = entry;
+		TXRegexCache.statistics.count++;
+		TXRegexCacheTrim(TXRegexCache.statistics.capacity);
+		compiled = NULL;
+	}
+	pthread_mutex_unlock(&TXRegexCache.lock);
+	if (compiled) uregex_close(compiled);
+	SafeRelease(literal);
+	return result;
+}
+
+void TXRegexCacheSetCapacity(CFIndex capacity)
+{
+	if (capacity < 0) capacity = 0;
+	pthread_mutex_lock(&TXRegexCache.lock);
+	TXRegexCache.statistics.capacity = capacity;
+	TXRegexCacheTrim(capacity);
+	pthread_mutex_unlock(&TXRegexCache.lock);
+}
+
+void TXRegexCacheRemoveAll(void)
+{
+	pthread_mutex_lock(&TXRegexCache.lock);
+	while (TXRegexCache.oldest) {
+		TXRegexCacheEntry *entry = TXRegexCache.oldest;
+		TXRegexCacheUnlinkEntry(entry);
+		TXRegexCacheFreeEntry(entry);
+	}
+	pthread_mutex_unlock(&TXRegexCache.lock);
+}
+
+void TXRegexCacheGetStatistics(TXRegexCacheStatistics *statistics)
+{
+	pthread_mutex_lock(&TXRegexCache.lock);
+	*statistics = TXRegexCache.statistics;
+	pthread_mutex_unlock(&TXRegexCache.lock);
+}
+
+#pragma mark shared patterns
+
+#define kTXRegexPatternPoolSize 64
+
+typedef struct {
+	TXRegexRef prototype;
+	TXRegexRef pool[kTXRegexPatternPoolSize]; // idle matchers. NULL for an empty slot.
+} TXRegexPatternStruct;
+
+static void TXRegexPatternDeallocate(void *ptr, void *info)
+{
+	TXRegexPatternStruct *pattern_struct = (TXRegexPatternStruct *)ptr;
+	for (int n = 0; n < kTXRegexPatternPoolSize; n++) {
+		SafeRelease(pattern_struct->pool[n]);
+	}
+	CFRelease(pattern_struct->prototype);
+	free(pattern_struct);
+}
+
+static CFAllocatorRef CreateTXRegexPatternDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexPatternDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+static unsigned int TXRegexPatternPoolStartSlot(void)
+{
+	// spread threads over the slots to reduce contention.
+	uintptr_t thread_id = (uintptr_t)pthread_self();
+	return (unsigned int)((thread_id >> 4) * 2654435761u) % kTXRegexPatternPoolSize;
+}
+
+TXRegexPatternRef TXRegexPatternCreateWithRegex(CFAllocatorRef allocator, TXRegexRef regexp, UErrorCode *status)
+{
+	TXRegexRef prototype = TXRegexCreateCopy(allocator, regexp, status);
+	if (!prototype) return NULL;
+	TXRegexPatternStruct *pattern_struct = calloc(1, sizeof(TXRegexPatternStruct));
+	if (!pattern_struct) {
+		CFRelease(prototype);
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	pattern_struct->prototype = prototype;
+	CFAllocatorRef deallocator = CreateTXRegexPatternDeallocator();
+	// the pool outlives TXRegexArenaReset, same as a regular expression.
+	CFAllocatorRef object_allocator = TXRegexAllocatorIsArena(allocator) ? kCFAllocatorDefault : allocator;
+	return CFDataCreateWithBytesNoCopy(object_allocator, (const UInt8 *)pattern_struct, 
+									   sizeof(TXRegexPatternStruct), deallocator);
+}
+
+TXRegexPatternRef TXRegexPatternCreate(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status)
+{
+	TXRegexRef regexp = TXRegexCreate(allocator, pattern, options, parse_error, status);
+	if (!regexp) return NULL;
+	if (U_ZERO_ERROR != *status) {
+		CFRelease(regexp);
+		return NULL;
+	}
+	TXRegexPatternRef result = TXRegexPatternCreateWithRegex(allocator, regexp, status);
+	CFRelease(regexp);
+	return result;
+}
+
+TXRegexRef TXRegexPatternCheckOutMatcher(TXRegexPatternRef pattern, UErrorCode *status)
+{
+	TXRegexPatternStruct *pattern_struct = (TXRegexPatternStruct *)CFDataGetBytePtr(pattern);
+	unsigned int start = TXRegexPatternPoolStartSlot();
+	for (unsigned int n = 0; n < kTXRegexPatternPoolSize; n++) {
+		TXRegexRef *slot = &pattern_struct->pool[(start + n) % kTXRegexPatternPoolSize];
+		TXRegexRef matcher = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+		if (matcher && __atomic_compare_exchange_n(slot, &matcher, NULL, false,
+												   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return matcher;
+	}
+	TXRegexStruct *prototype_struct = TXRegexGetStruct(pattern_struct->prototype);
+	return TXRegexCreateCopy(prototype_struct->resultAllocator, pattern_struct->prototype, status);
+}
+
+/*
+ Undo the settings a borrower may have changed, so that the next borrower gets a matcher
+ same as a fresh copy of the prototype.
+ */
+static void TXRegexPatternRestoreMatcher(TXRegexStruct *matcher_struct, const TXRegexStruct *prototype_struct,
+										 UErrorCode *status)
+{
+	matcher_struct->timeLimit = prototype_struct->timeLimit;
+	matcher_struct->stackLimit = prototype_struct->stackLimit;
+	matcher_struct->matchCallback = prototype_struct->matchCallback;
+	matcher_struct->matchCallbackInfo = prototype_struct->matchCallbackInfo;
+	TXRegexApplyLimits(matcher_struct, matcher_struct->uregexp, status);
+	matcher_struct->region = prototype_struct->region;
+	matcher_struct->regionTransparentBounds = prototype_struct->regionTransparentBounds;
+	matcher_struct->regionAnchoringBounds = prototype_struct->regionAnchoringBounds;
+	matcher_struct->offsetUnit = prototype_struct->offsetUnit;
+	matcher_struct->groupMode = prototype_struct->groupMode;
+	if (matcher_struct->resultAllocator != prototype_struct->resultAllocator) {
+		SafeRelease(matcher_struct->resultAllocator);
+		matcher_struct->resultAllocator = prototype_struct->resultAllocator;
+		if (matcher_struct->resultAllocator) CFRetain(matcher_struct->resultAllocator);
+	}
+	// cached results do not depend on the settings, so the entries are kept when the capacity is the same.
+	CFIndex capacity = prototype_struct->resultCache ? prototype_struct->resultCache->statistics.capacity : 0;
+	CFIndex current = matcher_struct->resultCache ? matcher_struct->resultCache->statistics.capacity : 0;
+	if (current != capacity) TXRegexResultCacheSetCapacity(matcher_struct, capacity, status);
+}
+
+void TXRegexPatternCheckInMatcher(TXRegexPatternRef pattern, TXRegexRef regexp)
+{
+	TXRegexPatternStruct *pattern_struct = (TXRegexPatternStruct *)CFDataGetBytePtr(pattern);
+	TXRegexStruct *matcher_struct = TXRegexGetStruct(regexp);
+	TXRegexStruct *prototype_struct = TXRegexGetStruct(pattern_struct->prototype);
+	TXRegexResetTarget(matcher_struct);
+	UErrorCode status = U_ZERO_ERROR;
+	TXRegexPatternRestoreMatcher(matcher_struct, prototype_struct, &status);
+	if (U_ZERO_ERROR != status) {
+		CFRelease(regexp);
+		return;
+	}
+	unsigned int start = TXRegexPatternPoolStartSlot();
+	for (unsigned int n = 0; n < kTXRegexPatternPoolSize; n++) {
+		TXRegexRef *slot = &pattern_struct->pool[(start + n) % kTXRegexPatternPoolSize];
+		TXRegexRef empty = NULL;
+		if (!__atomic_load_n(slot, __ATOMIC_RELAXED)
+			&& __atomic_compare_exchange_n(slot, &empty, regexp, false,
+										   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return;
+	}
+	CFRelease(regexp);
+}
+
+#pragma mark parallel matching
+
+#define kTXRegexParallelMinChunkLength 32768
+
+typedef struct {
+	URegularExpression *uregexp; // a clone which the target text is shared with.
+	int32_t chunkStart;
+	int32_t chunkEnd; // matches starting at or after chunkEnd belong to the next chunk.
+	int32_t overlap;
+	int32_t length;
+	int32_t gcount;
+	int32_t *offsets; // start and end of each group of each match.
+	CFStringRef text;
+	CFAllocatorRef allocator; // of the match arrays.
+	TXRegexStruct *regexpStruct; // of the caller, where the searches are recorded.
+	CFMutableArrayRef matches;
+	CFIndex matchCount;
+	CFIndex capacity;
+	Boolean started;
+	UErrorCode status;
+} TXRegexChunk;
+
+static void CFArrayAppendMatchWithOffsets(CFAllocatorRef allocator, CFMutableArrayRef matches, CFStringRef text,
+										  const int32_t *offsets, int32_t gcount)
+{
+	CFMutableArrayRef groups = CFArrayCreateMutable(allocator, gcount, &kCFTypeArrayCallBacks);
+	for (int32_t n = 0; n < gcount; n++) {
+		int32_t start = offsets[2*n];
+		int32_t end = offsets[2*n+1];
+		CFStringRef group_text = NULL;
+		if (-1 == start) {
+			group_text = CFRetain(CFSTR(""));
+		} else {
+			group_text = CFStringCreateWithSubstring(allocator, text, CFRangeMake(start, end-start));
+		}
+		CFDictionaryRef dict = CFDictionaryCreateWithCapturedGroup(allocator, start, end, group_text);
+		CFArrayAppendValue(groups, dict);
+		CFRelease(dict);
+		CFRelease(group_text);
+	}
+	CFArrayAppendValue(matches, groups);
+	CFRelease(groups);
+}
+
+static Boolean TXRegexChunkAppendMatch(TXRegexChunk *chunk, URegularExpression *re)
+{
+	if (chunk->matchCount == chunk->capacity) {
+		chunk->capacity = chunk->capacity ? chunk->capacity*2 : 64;
+		chunk->offsets = reallocf(chunk->offsets, chunk->capacity * chunk->gcount * 2 * sizeof(int32_t));
+		if (!chunk->offsets) {
+			chunk->status = U_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+	}
+	int32_t *offsets = chunk->offsets + chunk->matchCount * chunk->gcount * 2;
+	for (int32_t n = 0; n < chunk->gcount; n++) {
+		offsets[2*n] = uregex_start(re, n, &chunk->status);
+		offsets[2*n+1] = uregex_end(re, n, &chunk->status);
+	}
+	if (U_ZERO_ERROR != chunk->status) return false;
+	CFArrayAppendMatchWithOffsets(chunk->allocator, chunk->matches, chunk->text, offsets, chunk->gcount);
+	chunk->matchCount++;
+	return true;
+}
+
+static int32_t TXRegexPositionAfterMatch(const UniChar *uchars, int32_t length, int32_t start, int32_t end)
+{
+	// Same as uregex_findNext, an empty match moves the search position to the next code point.
+	if (start != end) return end;
+	if ((end+1 < length) && (0xD800 == (uchars[end] & 0xFC00)) && (0xDC00 == (uchars[end+1] & 0xFC00))) {
+		return end+2;
+	}
+	return end+1;
+}
+
+/*
+ Find the next match starting before chunkEnd. The region is limited by chunkEnd + overlap.
+ A match reaching the region limit may be cut by the limit, so the region is widened and
+ searched again from position, the end of the previous match.
+ */
+static Boolean TXRegexChunkFindNext(URegularExpression *re, TXRegexChunk *chunk, int32_t region_start,
+									int32_t position, int32_t *limit, UErrorCode *status)
+{
+	while (true) {
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		UBool found = uregex_findNext(re, status);
+		TXRegexStatisticsRecordSearch(chunk->regexpStruct, start_time, found, *status);
+		if (!found || (U_ZERO_ERROR != *status)) return false;
+		if (uregex_start(re, 0, status) >= chunk->chunkEnd) return false;
+		if ((*limit == chunk->length) || (uregex_end(re, 0, status) < *limit)) return true;
+		*limit = (*limit - position < chunk->length - *limit) ? *limit + (*limit - position) : chunk->length;
+		uregex_setRegionAndStart(re, region_start, *limit, position, status);
+	}
+}
+
+static void *TXRegexChunkSearch(void *info)
+{
+	TXRegexChunk *chunk = (TXRegexChunk *)info;
+	URegularExpression *re = chunk->uregexp;
+	int32_t text_length;
+	const UniChar *uchars = uregex_getText(re, &text_length, &chunk->status);
+	int32_t limit = (chunk->chunkEnd < chunk->length - chunk->overlap) ?
+						chunk->chunkEnd + chunk->overlap : chunk->length;
+	int32_t position = chunk->chunkStart;
+	uregex_setRegion(re, chunk->chunkStart, limit, &chunk->status);
+	while ((position < chunk->chunkEnd) && (U_ZERO_ERROR == chunk->status)) {
+		if (!TXRegexChunkFindNext(re, chunk, chunk->chunkStart, position, &limit, &chunk->status)) break;
+		if (!TXRegexChunkAppendMatch(chunk, re)) break;
+		int32_t *offsets = chunk->offsets + (chunk->matchCount-1) * chunk->gcount * 2;
+		position = TXRegexPositionAfterMatch(uchars, chunk->length, offsets[0], offsets[1]);
+	}
+	return NULL;
+}
+
+CFArrayRef TXRegexAllMatchesInStringParallel(TXRegexRef regexp, CFStringRef text, CFIndex maxMatchLength,
+											 CFIndex threadCount, UErrorCode *status)
+{
+	if (threadCount <= 0) threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+	CFIndex length = CFStringGetLength(text);
+	CFIndex chunk_count = length / kTXRegexParallelMinChunkLength;
+	if (chunk_count > threadCount) chunk_count = threadCount;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	// the chunks are regions themselves.
+	if ((chunk_count < 2) || (kCFNotFound != regexp_struct->region.location)) {
+		return TXRegexAllMatchesInString(regexp, text, status);
+	}
+	
+	if (!TXRegexSetString(regexp, text, status)) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	URegularExpression *re = regexp_struct->uregexp;
+	int32_t text_length;
+	const UniChar *uchars = uregex_getText(re, &text_length, status);
+	int32_t gcount = uregex_groupCount(re, status) + 1;
+	if (U_ZERO_ERROR != *status) return NULL;
+	if (maxMatchLength < 1) maxMatchLength = 1;
+	if (maxMatchLength > length) maxMatchLength = length;
+	
+	TXRegexChunk *chunks = calloc(chunk_count, sizeof(TXRegexChunk));
+	pthread_t *threads = calloc(chunk_count, sizeof(pthread_t));
+	CFMutableArrayRef matches = NULL;
+	if (!chunks || !threads) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	int32_t chunk_start = 0;
+	for (CFIndex n = 0; n < chunk_count; n++) {
+		TXRegexChunk *chunk = &chunks[n];
+		int32_t chunk_end = (int32_t)(length * (n+1) / chunk_count);
+		// do not split a surrogate pair.
+		if ((chunk_end < length) && (0xDC00 == (uchars[chunk_end] & 0xFC00))) chunk_end++;
+		// the last chunk also owns an empty match at the end of the text.
+		if (chunk_end == length) chunk_end++;
+		chunk->chunkStart = chunk_start;
+		chunk->chunkEnd = chunk_end;
+		chunk->overlap = (int32_t)maxMatchLength;
+		chunk->length = (int32_t)length;
+		chunk->gcount = gcount;
+		chunk->text = text;
+		chunk->allocator = regexp_struct->resultAllocator;
+		chunk->regexpStruct = regexp_struct;
+		chunk->matches = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+		chunk->status = U_ZERO_ERROR;
+		chunk->uregexp = uregex_clone(re, &chunk->status);
+		if (U_ZERO_ERROR == chunk->status) {
+			TXRegexApplyLimits(regexp_struct, chunk->uregexp, &chunk->status);
+			uregex_setText(chunk->uregexp, uchars, (int32_t)length, &chunk->status);
+			uregex_useTransparentBounds(chunk->uregexp, true, &chunk->status);
+			uregex_useAnchoringBounds(chunk->uregexp, false, &chunk->status);
+		}
+		if (U_ZERO_ERROR == chunk->status) {
+			chunk->started = !pthread_create(&threads[n], NULL, TXRegexChunkSearch, chunk);
+			if (!chunk->started) chunk->status = U_INTERNAL_PROGRAM_ERROR;
+		}
+		chunk_start = chunk_end;
+	}
+	for (CFIndex n = 0; n < chunk_count; n++) {
+		if (chunks[n].started) pthread_join(threads[n], NULL);
+		if ((U_ZERO_ERROR != chunks[n].status) && (U_ZERO_ERROR == *status)) *status = chunks[n].status;
+	}
+	if (U_ZERO_ERROR != *status) goto bail;
+	
+	/*
+	 Stitch the chunks. When the last match of a chunk runs over the start of the next chunk,
+	 the next chunk is searched again from the end of that match until the matches coincide.
+	 */
+	uregex_useTransparentBounds(re, true, status);
+	uregex_useAnchoringBounds(re, false, status);
+	matches = CFArrayCreateMutable(regexp_struct->resultAllocator, 0, &kCFTypeArrayCallBacks);
+	int32_t *offsets = malloc(gcount * 2 * sizeof(int32_t));
+	int32_t position = 0;
+	for (CFIndex n = 0; (n < chunk_count) && offsets; n++) {
+		TXRegexChunk *chunk = &chunks[n];
+		CFIndex m = 0;
+		if (position > chunk->chunkStart) {
+			if (position >= chunk->chunkEnd) continue; // the chunk is covered by the previous match.
+			Boolean synchronized = false;
+			int32_t limit = (chunk->chunkEnd < length - chunk->overlap) ?
+								chunk->chunkEnd + chunk->overlap : (int32_t)length;
+			uregex_setRegionAndStart(re, 0, limit, position, status);
+			while ((position < chunk->chunkEnd)
+				   && TXRegexChunkFindNext(re, chunk, 0, position, &limit, status)) {
+				int32_t start = uregex_start(re, 0, status);
+				int32_t end = uregex_end(re, 0, status);
+				while ((m < chunk->matchCount) && (chunk->offsets[m * gcount * 2] < start)) m++;
+				if ((m < chunk->matchCount) && (chunk->offsets[m * gcount * 2] == start)
+					&& (chunk->offsets[m * gcount * 2 + 1] == end)) {
+					synchronized = true;
+					break;
+				}
+				for (int32_t g = 0; g < gcount; g++) {
+					offsets[2*g] = uregex_start(re, g, status);
+					offsets[2*g+1] = uregex_end(re, g, status);
+				}
+				CFArrayAppendMatchWithOffsets(regexp_struct->resultAllocator, matches, text, offsets, gcount);
+				position = TXRegexPositionAfterMatch(uchars, (int32_t)length, start, end);
+			}
+			if (U_ZERO_ERROR != *status) break;
+			if (!synchronized) continue;
+		}
+		for (; m < chunk->matchCount; m++) {
+			CFArrayAppendValue(matches, CFArrayGetValueAtIndex(chunk->matches, m));
+			int32_t *chunk_offsets = chunk->offsets + m * gcount * 2;
+			position = TXRegexPositionAfterMatch(uchars, (int32_t)length, chunk_offsets[0], chunk_offsets[1]);
+		}
+	}
+	if (!offsets) *status = U_MEMORY_ALLOCATION_ERROR;
+	free(offsets);
+	uregex_useTransparentBounds(re, false, status);
+	uregex_useAnchoringBounds(re, true, status);
+	uregex_reset(re, 0, status);
+	
+bail:
+	if (chunks) {
+		for (CFIndex n = 0; n < chunk_count; n++) {
+			if (chunks[n].uregexp) uregex_close(chunks[n].uregexp);
+			SafeRelease(chunks[n].matches);
+			free(chunks[n].offsets);
+		}
+	}
+	free(chunks);
+	free(threads);
+	if ((U_ZERO_ERROR != *status) && matches) {
+		CFRelease(matches);
+		matches = NULL;
+	}
+	return matches;
+}
+
+#pragma mark batch matching
+
+#define kTXRegexBatchBlockSize 64 // strings taken by a worker at a time
+#define kTXRegexBatchMinCountPerThread 256
+
+typedef struct {
+	TXRegexRef regexp; // regexp of TXRegexMatchBatch for the first worker, a clone for the others.
+	const CFStringRef *texts;
+	CFIndex count;
+	int32_t gcount;
+	Boolean *matched;
+	CFRange *ranges; // groups of all strings. compacted after the search.
+	CFIndex *next; // the next string to take, shared by workers.
+	int *failed; // shared by workers to stop on an error.
+	Boolean started;
+	UErrorCode status;
+} TXRegexBatchWorker;
+
+static void *TXRegexBatchWork(void *info)
+{
+	TXRegexBatchWorker *worker = (TXRegexBatchWorker *)info;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(worker->regexp);
+	URegularExpression *re = regexp_struct->uregexp;
+	while (!__atomic_load_n(worker->failed, __ATOMIC_RELAXED)) {
+		CFIndex begin = __atomic_fetch_add(worker->next, kTXRegexBatchBlockSize, __ATOMIC_RELAXED);
+		if (begin >= worker->count) break;
+		CFIndex end = (begin + kTXRegexBatchBlockSize < worker->count) ? begin + kTXRegexBatchBlockSize : worker->count;
+		for (CFIndex n = begin; n < end; n++) {
+			UBool found = false;
+			const UniChar *uchars = NULL;
+			int32_t length = 0;
+			TXRegexSetString(worker->regexp, worker->texts[n], &worker->status);
+			if (TXRegexGetPatternLiteralTarget(regexp_struct, &uchars, &length, &worker->status)) {
+				// a literal pattern has no groups.
+				CFIndex location = TXRegexFindPatternLiteral(regexp_struct, uchars, length, 0);
+				found = (kCFNotFound != location);
+				if (found) worker->ranges[n] = CFRangeMake(location, regexp_struct->patternLiteralLength);
+			} else if (U_ZERO_ERROR == worker->status) {
+				found = TXRegexFind(regexp_struct, 0, &worker->status);
+				if (found) {
+					CFRange *ranges = worker->ranges + n * worker->gcount;
+					for (int32_t g = 0; g < worker->gcount; g++) {
+						int32_t start = uregex_start(re, g, &worker->status);
+						int32_t end = uregex_end(re, g, &worker->status);
+						ranges[g] = (-1 == start) ? CFRangeMake(kCFNotFound, 0) : CFRangeMake(start, end - start);
+					}
+				}
+			}
+			if (U_ZERO_ERROR != worker->status) {
+				__atomic_store_n(worker->failed, 1, __ATOMIC_RELAXED);
+				return NULL;
+			}
+			worker->matched[n] = found;
+		}
+	}
+	return NULL;
+}
+
+static void TXRegexBatchDeallocate(void *ptr, void *info)
+{
+	TXRegexBatchResults *results = (TXRegexBatchResults *)ptr;
+	free(results->matched);
+	free(results->indexes);
+	free(results->ranges);
+	free(results);
+}
+
+static CFAllocatorRef CreateTXRegexBatchDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexBatchDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+TXRegexBatchRef TXRegexMatchBatch(CFAllocatorRef allocator, TXRegexRef regexp, const CFStringRef *texts, CFIndex count,
+								  CFIndex threadCount, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	int32_t gcount = uregex_groupCount(regexp_struct->uregexp, status) + 1;
+	if (U_ZERO_ERROR != *status) return NULL;
+	if (threadCount <= 0) threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+	CFIndex worker_count = count / kTXRegexBatchMinCountPerThread;
+	if (worker_count > threadCount) worker_count = threadCount;
+	if (worker_count < 1) worker_count = 1;
+	
+	TXRegexBatchResults *results = calloc(1, sizeof(TXRegexBatchResults));
+	TXRegexBatchWorker *workers = calloc(worker_count, sizeof(TXRegexBatchWorker));
+	pthread_t *threads = calloc(worker_count, sizeof(pthread_t));
+	if (!results || !workers || !threads) goto nomemory;
+	results->count = count;
+	results->groupCount = gcount;
+	results->matched = malloc((count ? count : 1) * sizeof(Boolean));
+	results->ranges = malloc((count ? count : 1) * gcount * sizeof(CFRange));
+	if (!results->matched || !results->ranges) goto nomemory;
+	
+	CFIndex next = 0;
+	int failed = 0;
+	for (CFIndex n = 0; n < worker_count; n++) {
+		TXRegexBatchWorker *worker = &workers[n];
+		worker->regexp = n ? TXRegexCreateCopy(kCFAllocatorDefault, regexp, &worker->status) : regexp;
+		if (!worker->regexp) {
+			// same as a thread which could not start, the other workers take the strings.
+			worker->status = U_ZERO_ERROR;
+			continue;
+		}
+		worker->texts = texts;
+		worker->count = count;
+		worker->gcount = gcount;
+		worker->matched = results->matched;
+		worker->ranges = results->ranges;
+		worker->next = &next;
+		worker->failed = &failed;
+		// the strings left by a worker which could not start are taken by the others.
+		if (n) worker->started = !pthread_create(&threads[n], NULL, TXRegexBatchWork, worker);
+	}
+	TXRegexBatchWork(&workers[0]);
+	for (CFIndex n = 0; n < worker_count; n++) {
+		TXRegexBatchWorker *worker = &workers[n];
+		if (worker->started) pthread_join(threads[n], NULL);
+		if ((U_ZERO_ERROR != worker->status) && (U_ZERO_ERROR == *status)) *status = worker->status;
+		if (n) SafeRelease(worker->regexp);
+	}
+	TXRegexResetTarget(regexp_struct);
+	if (U_ZERO_ERROR != *status) goto bail;
+	
+	// move the groups of matched strings to the front.
+	results->indexes = malloc((count ? count : 1) * sizeof(CFIndex));
+	if (!results->indexes) goto nomemory;
+	CFIndex match_count = 0;
+	for (CFIndex n = 0; n < count; n++) {
+		if (!results->matched[n]) continue;
+		if (match_count != n) {
+			memmove(results->ranges + match_count * gcount, results->ranges + n * gcount, gcount * sizeof(CFRange));
+		}
+		results->indexes[match_count++] = n;
+	}
+	results->matchCount = match_count;
+	free(workers);
+	free(threads);
+	return CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)results,
+									   sizeof(TXRegexBatchResults), CreateTXRegexBatchDeallocator());
+nomemory:
+	*status = U_MEMORY_ALLOCATION_ERROR;
+bail:
+	if (results) TXRegexBatchDeallocate(results, NULL);
+	free(workers);
+	free(threads);
+	return NULL;
+}
+
+TXRegexBatchRef TXRegexMatchBatchWithArray(CFAllocatorRef allocator, TXRegexRef regexp, CFArrayRef texts,
+										   CFIndex threadCount, UErrorCode *status)
+{
+	CFIndex count = CFArrayGetCount(texts);
+	CFStringRef *strings = malloc((count ? count : 1) * sizeof(CFStringRef));
+	if (!strings) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	CFArrayGetValues(texts, CFRangeMake(0, count), (const void **)strings);
+	TXRegexBatchRef result = TXRegexMatchBatch(allocator, regexp, strings, count, threadCount, status);
+	free(strings);
+	return result;
+}
+
+const TXRegexBatchResults *TXRegexBatchGetResults(TXRegexBatchRef batch)
+{
+	return (const TXRegexBatchResults *)CFDataGetBytePtr(batch);
+}
+
+#pragma mark asynchronous matching
+
+typedef struct TXRegexJobStruct {
+	TXRegexJobRef job; // the object of this struct, retained by the pool until the job finishes.
+	TXRegexRef regexp; // a copy owned by the job, released when the job finishes.
+	CFStringRef text;
+	TXRegexJobCallBack callback;
+	void *info;
+	TXRegexMatchCallback matchCallback; // of the copied regexp, called after the check of cancellation.
+	void *matchCallbackInfo;
+	int cancelled;
+	pthread_mutex_t lock;
+	pthread_cond_t finishedCondition;
+	Boolean finished;
+	CFArrayRef matches;
+	UErrorCode status;
+	struct TXRegexJobStruct *next; // in a work queue
+} TXRegexJobStruct;
+
+#define TXRegexJobGetStruct(x) ((TXRegexJobStruct *)CFDataGetBytePtr(x))
+
+typedef struct {
+	TXRegexJobStruct *head;
+	TXRegexJobStruct *tail;
+} TXRegexWorkQueue;
+
+static struct {
+	TXRegexWorkQueue *queues; // one for each worker thread.
+	CFIndex queueCount;
+	CFIndex workerCount; // threads actually started.
+	CFIndex pending; // jobs in the queues.
+	unsigned int nextQueue;
+	pthread_mutex_t lock; // guards the queues and pending.
+	pthread_cond_t wakeup;
+} TXRegexWorkPool = {NULL, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static pthread_once_t TXRegexWorkPoolOnce = PTHREAD_ONCE_INIT;
+
+static void TXRegexJobDeallocate(void *ptr, void *info)
+{
+	TXRegexJobStruct *job_struct = (TXRegexJobStruct *)ptr;
+	SafeRelease(job_struct->regexp);
+	SafeRelease(job_struct->text);
+	SafeRelease(job_struct->matches);
+	pthread_mutex_destroy(&job_struct->lock);
+	pthread_cond_destroy(&job_struct->finishedCondition);
+	free(job_struct);
+}
+
+static CFAllocatorRef CreateTXRegexJobDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexJobDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+static Boolean TXRegexJobIsCancelled(TXRegexJobStruct *job_struct)
+{
+	return __atomic_load_n(&job_struct->cancelled, __ATOMIC_RELAXED);
+}
+
+static Boolean TXRegexJobMatchCallback(int32_t steps, void *info)
+{
+	TXRegexJobStruct *job_struct = (TXRegexJobStruct *)info;
+	if (TXRegexJobIsCancelled(job_struct)) return false;
+	if (job_struct->matchCallback) return job_struct->matchCallback(steps, job_struct->matchCallbackInfo);
+	return true;
+}
+
+static void TXRegexJobRun(TXRegexJobStruct *job_struct)
+{
+	UErrorCode status = U_ZERO_ERROR;
+	CFMutableArrayRef matches = NULL;
+	TXRegexRef regexp = job_struct->regexp;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexJobIsCancelled(job_struct)) {
+		TXRegexSetString(regexp, job_struct->text, &status);
+		if (U_ZERO_ERROR == status) {
+			matches = CFArrayCreateMutable(regexp_struct->resultAllocator, 0, &kCFTypeArrayCallBacks);
+			CFArrayRef a_match = NULL;
+			while (!TXRegexJobIsCancelled(job_struct) && (a_match = TXRegexNextMatch(regexp, &status))) {
+				if (U_ZERO_ERROR != status) {
+					CFRelease(a_match);
+					break;
+				}
+				CFArrayAppendValue(matches, a_match);
+				CFRelease(a_match);
+			}
+		}
+	}
+	if (TXRegexJobIsCancelled(job_struct) && (U_ZERO_ERROR == status)) status = U_REGEX_STOPPED_BY_CALLER;
+	if ((U_ZERO_ERROR != status) && matches) {
+		CFRelease(matches);
+		matches = NULL;
+	}
+	// the copy is not needed any more. It holds the target and a matcher of ICU.
+	job_struct->regexp = NULL;
+	CFRelease(regexp);
+	
+	pthread_mutex_lock(&job_struct->lock);
+	job_struct->matches = matches;
+	job_struct->status = status;
+	job_struct->finished = true;
+	pthread_cond_broadcast(&job_struct->finishedCondition);
+	pthread_mutex_unlock(&job_struct->lock);
+	if (job_struct->callback) job_struct->callback(job_struct->job, matches, status, job_struct->info);
+	CFRelease(job_struct->job);
+}
+
+/*
+ Take a job from the own queue first, then steal from the queues of the other workers.
+ Called with the lock of the pool held, so that pending always counts the queued jobs.
+ */
+static TXRegexJobStruct *TXRegexWorkPoolTake(CFIndex index)
+{
+	CFIndex queue_count = TXRegexWorkPool.queueCount;
+	for (CFIndex n = 0; n < queue_count; n++) {
+		TXRegexWorkQueue *queue = &TXRegexWorkPool.queues[(index + n) % queue_count];
+		TXRegexJobStruct *job_struct = queue->head;
+		if (!job_struct) continue;
+		queue->head = job_struct->next;
+		if (!queue->head) queue->tail = NULL;
+		TXRegexWorkPool.pending--;
+		return job_struct;
+	}
+	return NULL;
+}
+
+static void *TXRegexWorkerRun(void *info)
+{
+	CFIndex index = (CFIndex)(intptr_t)info;
+	pthread_mutex_lock(&TXRegexWorkPool.lock);
+	while (true) {
+		TXRegexJobStruct *job_struct = TXRegexWorkPool.pending ? TXRegexWorkPoolTake(index) : NULL;
+		if (!job_struct) {
+			pthread_cond_wait(&TXRegexWorkPool.wakeup, &TXRegexWorkPool.lock);
+			continue;
+		}
+		pthread_mutex_unlock(&TXRegexWorkPool.lock);
+		TXRegexJobRun(job_struct);
+		pthread_mutex_lock(&TXRegexWorkPool.lock);
+	}
+	return NULL;
+}
+
+static void TXRegexWorkPoolStart(void)
+{
+	CFIndex count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count < 1) count = 1;
+	TXRegexWorkQueue *queues = calloc(count, sizeof(TXRegexWorkQueue));
+	if (!queues) return;
+	TXRegexWorkPool.queues = queues;
+	TXRegexWorkPool.queueCount = count;
+	// the queue of a thread which could not start is emptied by the others.
+	for (CFIndex n = 0; n < count; n++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, TXRegexWorkerRun, (void *)(intptr_t)n)) continue;
+		pthread_detach(thread);
+		TXRegexWorkPool.workerCount++;
+	}
+}
+
+static void TXRegexWorkPoolSubmit(TXRegexJobStruct *job_struct)
+{
+	unsigned int index = __atomic_fetch_add(&TXRegexWorkPool.nextQueue, 1, __ATOMIC_RELAXED);
+	TXRegexWorkQueue *queue = &TXRegexWorkPool.queues[index % TXRegexWorkPool.queueCount];
+	pthread_mutex_lock(&TXRegexWorkPool.lock);
+	job_struct->next = NULL;
+	if (queue->tail) queue->tail->next = job_struct;
+	else queue->head = job_struct;
+	queue->tail = job_struct;
+	TXRegexWorkPool.pending++;
+	pthread_cond_signal(&TXRegexWorkPool.wakeup);
+	pthread_mutex_unlock(&TXRegexWorkPool.lock);
+}
+
+TXRegexJobRef TXRegexAllMatchesAsync(CFAllocatorRef allocator, TXRegexRef regexp, CFStringRef text,
+									 TXRegexJobCallBack callback, void *info, UErrorCode *status)
+{
+	pthread_once(&TXRegexWorkPoolOnce, TXRegexWorkPoolStart);
+	if (!TXRegexWorkPool.workerCount) {
+		*status = U_INTERNAL_PROGRAM_ERROR;
+		return NULL;
+	}
+	TXRegexJobStruct *job_struct = calloc(1, sizeof(TXRegexJobStruct));
+	if (!job_struct) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	pthread_mutex_init(&job_struct->lock, NULL);
+	pthread_cond_init(&job_struct->finishedCondition, NULL);
+	job_struct->callback = callback;
+	job_struct->info = info;
+	job_struct->status = U_ZERO_ERROR;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	job_struct->regexp = TXRegexCreateCopy(regexp_struct->resultAllocator, regexp, status);
+	if (!job_struct->regexp || (U_ZERO_ERROR != *status)) goto bail;
+	TXRegexStruct *copy_struct = TXRegexGetStruct(job_struct->regexp);
+	job_struct->matchCallback = copy_struct->matchCallback;
+	job_struct->matchCallbackInfo = copy_struct->matchCallbackInfo;
+	TXRegexSetMatchCallback(job_struct->regexp, TXRegexJobMatchCallback, job_struct, status);
+	if (U_ZERO_ERROR != *status) goto bail;
+	job_struct->text = CFStringCreateCopy(kCFAllocatorDefault, text);
+	
+	TXRegexJobRef job = CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)job_struct,
+													sizeof(TXRegexJobStruct), CreateTXRegexJobDeallocator());
+	job_struct->job = job;
+	CFRetain(job); // released by the worker when the job finished.
+	TXRegexWorkPoolSubmit(job_struct);
+	return job;
+bail:
+	TXRegexJobDeallocate(job_struct, NULL);
+	return NULL;
+}
+
+void TXRegexJobCancel(TXRegexJobRef job)
+{
+	__atomic_store_n(&TXRegexJobGetStruct(job)->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+Boolean TXRegexJobIsFinished(TXRegexJobRef job)
+{
+	TXRegexJobStruct *job_struct = TXRegexJobGetStruct(job);
+	pthread_mutex_lock(&job_struct->lock);
+	Boolean finished = job_struct->finished;
+	pthread_mutex_unlock(&job_struct->lock);
+	return finished;
+}
+
+CFArrayRef TXRegexJobGetMatches(TXRegexJobRef job, UErrorCode *status)
+{
+	TXRegexJobStruct *job_struct = TXRegexJobGetStruct(job);
+	pthread_mutex_lock(&job_struct->lock);
+	while (!job_struct->finished) pthread_cond_wait(&job_struct->finishedCondition, &job_struct->lock);
+	pthread_mutex_unlock(&job_struct->lock);
+	*status = job_struct->status;
+	return job_struct->matches;
+}
+
+#pragma mark stream matching
+
+CFIndex TXRegexScanStream(TXRegexRef regexp, TXRegexStreamReadCallBack reader, void *readerInfo, CFIndex windowSize,
+						  TXRegexStreamMatchCallBack callback, void *callbackInfo, UErrorCode *status)
+{
+	static const UChar empty[] = {0};
+	if (windowSize <= 0) windowSize = kTXRegexStreamDefaultWindowSize;
+	if (windowSize < 4*kTXRegexStreamContextLength) windowSize = 4*kTXRegexStreamContextLength;
+	if (windowSize > INT32_MAX) windowSize = INT32_MAX;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	URegularExpression *re = regexp_struct->uregexp;
+	TXRegexResetTarget(regexp_struct);
+	int32_t gcount = uregex_groupCount(re, status) + 1;
+	if (U_ZERO_ERROR != *status) return 0;
+	
+	CFIndex match_count = 0;
+	UniChar *buffer = malloc(windowSize * sizeof(UniChar));
+	CFRange *ranges = malloc(gcount * sizeof(CFRange));
+	if (!buffer || !ranges) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	
+	/*
+	 Matches starting by threshold can not be changed by further input, as long as no match is
+	 longer than max_match_length. A match after threshold or depending on the end of the window
+	 is searched again after the window is moved.
+	 */
+	int32_t max_match_length = (int32_t)(windowSize - kTXRegexStreamContextLength)/2;
+	CFIndex base = 0; // the offset of buffer[0] in the stream.
+	int32_t filled = 0;
+	int32_t position = 0;
+	Boolean eof = false;
+	while (1) {
+		while (!eof && (filled < windowSize)) {
+			CFIndex n_read = reader(buffer+filled, windowSize-filled, readerInfo);
+			if (n_read < 0) {
+				*status = U_FILE_ACCESS_ERROR;
+				goto bail;
+			}
+			if (0 == n_read) eof = true;
+			filled += (int32_t)n_read;
+		}
+		int32_t length = filled;
+		// a lead surrogate at the end of the window waits for its trail surrogate.
+		if (!eof && (0xD800 == (buffer[length-1] & 0xFC00))) length--;
+		uregex_setText(re, buffer, length, status);
+		uregex_setRegionAndStart(re, 0, length, position, status);
+		if (U_ZERO_ERROR != *status) goto bail;
+		
+		int32_t threshold = length - max_match_length;
+		int32_t resume = -1;
+		while (1) {
+			uint64_t start_time = TXRegexStatisticsStartTime();
+			Boolean found = uregex_findNext(re, status);
+			TXRegexStatisticsRecordSearch(regexp_struct, start_time, found, *status);
+			if (U_ZERO_ERROR != *status) goto bail;
+			if (!found) {
+				if (!eof) resume = (position > threshold) ? position : threshold;
+				break;
+			}
+			int32_t start = uregex_start(re, 0, status);
+			int32_t end = uregex_end(re, 0, status);
+			if (!eof && ((start > threshold) || (end >= length)
+						 || uregex_hitEnd(re, status) || uregex_requireEnd(re, status))) {
+				resume = (start < threshold) ? start : threshold;
+				if (resume < position) resume = position;
+				if (resume > kTXRegexStreamContextLength) break;
+				// the window can not be moved any more. the match is accepted as it is.
+			}
+			TXRegexGetMatchRanges(regexp_struct, ranges, gcount, status);
+			if (U_ZERO_ERROR != *status) goto bail;
+			for (int32_t n = 0; n < gcount; n++) {
+				if (kCFNotFound != ranges[n].location) ranges[n].location += base;
+			}
+			match_count++;
+			if (!callback(regexp, ranges, gcount, callbackInfo)) goto bail;
+			position = TXRegexPositionAfterMatch(buffer, length, start, end);
+			resume = -1;
+		}
+		if (resume < 0) break;
+		
+		// move the window keeping kTXRegexStreamContextLength characters before resume for look-behind.
+		if ((resume > position) && (resume < filled) && (0xDC00 == (buffer[resume] & 0xFC00))
+			&& (0xD800 == (buffer[resume-1] & 0xFC00))) resume--;
+		int32_t discard = resume - kTXRegexStreamContextLength;
+		memmove(buffer, buffer+discard, (filled-discard) * sizeof(UniChar));
+		filled -= discard;
+		base += discard;
+		position = resume - discard;
+	}
+	
+bail:
+	{
+		UErrorCode reset_status = U_ZERO_ERROR;
+		uregex_setText(re, empty, 0, &reset_status);
+	}
+	free(buffer);
+	free(ranges);
+	return match_count;
+}
+
+typedef struct {
+	int fd;
+	int32_t byteCount; // bytes of an incomplete UTF-8 sequence waiting for the next read.
+	int32_t charStart;
+	int32_t charCount;
+	char bytes[4096];
+	UniChar chars[4096];
+} TXRegexUTF8Reader;
+
+static int32_t UTF8CompleteLength(const char *bytes, int32_t length)
+{
+	for (int32_t n = 1; (n <= 3) && (n <= length); n++) {
+		unsigned char c = (unsigned char)bytes[length-n];
+		if (0x80 == (c & 0xC0)) continue; // trail byte
+		int32_t sequence_length = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+		return (sequence_length > n) ? length-n : length;
+	}
+	return length;
+}
+
+static CFIndex TXRegexReadUTF8(UniChar *buffer, CFIndex capacity, void *info)
+{
+	TXRegexUTF8Reader *reader = (TXRegexUTF8Reader *)info;
+	while (reader->charStart == reader->charCount) {
+		ssize_t n_read = read(reader->fd, reader->bytes + reader->byteCount,
+							  sizeof(reader->bytes) - reader->byteCount);
+		if (n_read < 0) {
+			if (EINTR == errno) continue;
+			return -1;
+		}
+		int32_t length = reader->byteCount + (int32_t)n_read;
+		if (0 == length) return 0;
+		// at the end of file, an incomplete sequence is converted into U+FFFD.
+		int32_t complete = n_read ? UTF8CompleteLength(reader->bytes, length) : length;
+		UErrorCode status = U_ZERO_ERROR;
+		u_strFromUTF8WithSub(reader->chars, (int32_t)(sizeof(reader->chars)/sizeof(UniChar)), &reader->charCount,
+							 reader->bytes, complete, 0xFFFD, NULL, &status);
+		if (U_ZERO_ERROR < status) return -1; // a full buffer is reported as a warning.
+		reader->charStart = 0;
+		reader->byteCount = length - complete;
+		memmove(reader->bytes, reader->bytes + complete, reader->byteCount);
+	}
+	CFIndex count = reader->charCount - reader->charStart;
+	if (count > capacity) count = capacity;
+	memcpy(buffer, reader->chars + reader->charStart, count * sizeof(UniChar));
+	reader->charStart += (int32_t)count;
+	return count;
+}
+
+CFIndex TXRegexScanFileDescriptor(TXRegexRef regexp, int fd, CFIndex windowSize,
+								  TXRegexStreamMatchCallBack callback, void *callbackInfo, UErrorCode *status)
+{
+	TXRegexUTF8Reader *reader = calloc(1, sizeof(TXRegexUTF8Reader));
+	if (!reader) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return 0;
+	}
+	reader->fd = fd;
+	CFIndex match_count = TXRegexScanStream(regexp, TXRegexReadUTF8, reader, windowSize,
+											callback, callbackInfo, status);
+	free(reader);
+	return match_count;
+}
+
+#pragma mark pattern sets
+
+typedef struct {
+	UniChar character;
+	int32_t next;
+} TXRegexSetEdge;
+
+typedef struct {
+	int32_t edgeStart; // edges are sorted by character.
+	int32_t edgeCount;
+	int32_t fail;
+	int32_t output; // the first pattern whose literal ends at this node. -1 for none.
+	int32_t outputLink; // the nearest node having output on the fail chain. -1 for none.
+	uint32_t generation; // the scan which reported the output of this node.
+} TXRegexSetNode;
+
+typedef struct {
+	CFIndex count;
+	TXRegexRef *regexps;
+	int32_t *sameLiteral; // the next pattern having the same literal. -1 for none.
+	Boolean *hasLiteral;
+	CFIndex literalCount;
+	TXRegexSetNode *nodes;
+	int32_t nodeCount;
+	TXRegexSetEdge *edges;
+	uint32_t generation;
+} TXRegexSetStruct;
+
+static void TXRegexSetDeallocate(void *ptr, void *info)
+{
+	TXRegexSetStruct *set_struct = (TXRegexSetStruct *)ptr;
+	if (set_struct->regexps) {
+		for (CFIndex n = 0; n < set_struct->count; n++) {
+			SafeRelease(set_struct->regexps[n]);
+		}
+	}
+	free(set_struct->regexps);
+	free(set_struct->sameLiteral);
+	free(set_struct->hasLiteral);
+	free(set_struct->nodes);
+	free(set_struct->edges);
+	free(set_struct);
+}
+
+static CFAllocatorRef CreateTXRegexSetDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexSetDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+static int32_t TXRegexSetTransition(const TXRegexSetStruct *set_struct, int32_t node, UniChar c)
+{
+	const TXRegexSetEdge *edges = set_struct->edges + set_struct->nodes[node].edgeStart;
+	int32_t low = 0, high = set_struct->nodes[node].edgeCount;
+	while (low < high) {
+		int32_t middle = (low + high) / 2;
+		if (edges[middle].character < c) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if ((low < set_struct->nodes[node].edgeCount) && (edges[low].character == c)) return edges[low].next;
+	return -1;
+}
+
+/*
+ Build an Aho-Corasick automaton of the literals. The trie is built with lists of children,
+ which are flattened into sorted edges before the fail links are computed in breadth-first order.
+ */
+static Boolean TXRegexSetBuildAutomaton(TXRegexSetStruct *set_struct, CFStringRef *literals, CFIndex totalLength)
+{
+	Boolean result = false;
+	int32_t *first_child = malloc(totalLength * sizeof(int32_t));
+	int32_t *next_sibling = malloc(totalLength * sizeof(int32_t));
+	UniChar *labels = malloc(totalLength * sizeof(UniChar));
+	int32_t *queue = malloc(totalLength * sizeof(int32_t));
+	UniChar *uchars = malloc(totalLength * sizeof(UniChar));
+	set_struct->nodes = calloc(totalLength, sizeof(TXRegexSetNode));
+	set_struct->edges = malloc(totalLength * sizeof(TXRegexSetEdge));
+	if (!first_child || !next_sibling || !labels || !queue || !uchars || !set_struct->nodes || !set_struct->edges) goto bail;
+	
+	TXRegexSetNode *nodes = set_struct->nodes;
+	int32_t node_count = 1;
+	first_child[0] = -1;
+	nodes[0].output = -1;
+	for (CFIndex n = 0; n < set_struct->count; n++) {
+		set_struct->sameLiteral[n] = -1;
+		if (!literals[n]) continue;
+		CFIndex length = CFStringGetLength(literals[n]);
+		CFStringGetCharacters(literals[n], CFRangeMake(0, length), uchars);
+		int32_t node = 0;
+		for (CFIndex k = 0; k < length; k++) {
+			int32_t child = first_child[node];
+			while ((child >= 0) && (labels[child] != uchars[k])) child = next_sibling[child];
+			if (child < 0) {
+				child = node_count++;
+				labels[child] = uchars[k];
+				first_child[child] = -1;
+				next_sibling[child] = first_child[node];
+				first_child[node] = child;
+				nodes[child].output = -1;
+			}
+			node = child;
+		}
+		set_struct->sameLiteral[n] = nodes[node].output;
+		nodes[node].output = (int32_t)n;
+	}
+	set_struct->nodeCount = node_count;
+	
+	int32_t edge_count = 0;
+	for (int32_t node = 0; node < node_count; node++) {
+		nodes[node].edgeStart = edge_count;
+		for (int32_t child = first_child[node]; child >= 0; child = next_sibling[child]) {
+			// insertion sort by character
+			int32_t k = edge_count++;
+			while ((k > nodes[node].edgeStart) && (set_struct->edges[k-1].character > labels[child])) {
+				set_struct->edges[k] = set_struct->edges[k-1];
+				k--;
+			}
+			set_struct->edges[k].character = labels[child];
+			set_struct->edges[k].next = child;
+		}
+		nodes[node].edgeCount = edge_count - nodes[node].edgeStart;
+	}
+	
+	int32_t head = 0, tail = 0;
+	nodes[0].fail = 0;
+	nodes[0].outputLink = -1;
+	queue[tail++] = 0;
+	while (head < tail) {
+		int32_t node = queue[head++];
+		for (int32_t e = nodes[node].edgeStart; e < nodes[node].edgeStart + nodes[node].edgeCount; e++) {
+			int32_t child = set_struct->edges[e].next;
+			int32_t fail = 0;
+			if (node) {
+				for (int32_t state = nodes[node].fail; ; state = nodes[state].fail) {
+					int32_t next = TXRegexSetTransition(set_struct, state, set_struct->edges[e].character);
+					if (next >= 0) {
+						fail = next;
+						break;
+					}
+					if (!state) break;
+				}
+			}
+			nodes[child].fail = fail;
+			nodes[child].outputLink = (nodes[fail].output >= 0) ? fail : nodes[fail].outputLink;
+			queue[tail++] = child;
+		}
+	}
+	result = true;
+bail:
+	free(first_child);
+	free(next_sibling);
+	free(labels);
+	free(queue);
+	free(uchars);
+	return result;
+}
+
+TXRegexSetRef TXRegexSetCreate(CFAllocatorRef allocator, CFArrayRef patterns, uint32_t options,
+							   UParseError *parse_error, CFIndex *errorIndex, UErrorCode *status)
+{
+	TXRegexSetRef result = NULL;
+	CFIndex count = CFArrayGetCount(patterns);
+	CFStringRef *literals = calloc(count+1, sizeof(CFStringRef));
+	TXRegexSetStruct *set_struct = calloc(1, sizeof(TXRegexSetStruct));
+	if (!literals || !set_struct) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	set_struct->count = count;
+	set_struct->regexps = calloc(count+1, sizeof(TXRegexRef));
+	set_struct->sameLiteral = malloc((count+1) * sizeof(int32_t));
+	set_struct->hasLiteral = calloc(count+1, sizeof(Boolean));
+	if (!set_struct->regexps || !set_struct->sameLiteral || !set_struct->hasLiteral) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	
+	CFIndex total_length = 1; // the root
+	for (CFIndex n = 0; n < count; n++) {
+		CFStringRef pattern = CFArrayGetValueAtIndex(patterns, n);
+		set_struct->regexps[n] = TXRegexCreate(kCFAllocatorDefault, pattern, options, parse_error, status);
+		if (U_ZERO_ERROR != *status) {
+			if (errorIndex) *errorIndex = n;
+			goto bail;
+		}
+		literals[n] = CFStringCreateWithRequiredLiteral(pattern, options, NULL);
+		if (literals[n]) {
+			total_length += CFStringGetLength(literals[n]);
+			set_struct->hasLiteral[n] = true;
+			set_struct->literalCount++;
+		}
+	}
+	if (!TXRegexSetBuildAutomaton(set_struct, literals, total_length)) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	result = CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)set_struct,
+										 sizeof(TXRegexSetStruct), CreateTXRegexSetDeallocator());
+bail:
+	if (literals) {
+		for (CFIndex n = 0; n < count; n++) {
+			SafeRelease(literals[n]);
+		}
+	}
+	free(literals);
+	if (!result && set_struct) TXRegexSetDeallocate(set_struct, NULL);
+	return result;
+}
+
+CFIndex TXRegexSetGetCount(TXRegexSetRef set)
+{
+	TXRegexSetStruct *set_struct = (TXRegexSetStruct *)CFDataGetBytePtr(set);
+	return set_struct->count;
+}
+
+// Mark patterns whose literal occurs in uchars as candidates.
+static void TXRegexSetFindLiterals(TXRegexSetStruct *set_struct, const UniChar *uchars, CFIndex length, Boolean *candidates)
+{
+	TXRegexSetNode *nodes = set_struct->nodes;
+	if (0 == ++set_struct->generation) {
+		for (int32_t node = 0; node < set_struct->nodeCount; node++) nodes[node].generation = 0;
+		set_struct->generation = 1;
+	}
+	CFIndex remaining = set_struct->literalCount;
+	int32_t node = 0;
+	for (CFIndex n = 0; (n < length) && remaining; n++) {
+		while (1) {
+			int32_t next = TXRegexSetTransition(set_struct, node, uchars[n]);
+			if (next >= 0) {
+				node = next;
+				break;
+			}
+			if (!node) break;
+			node = nodes[node].fail;
+		}
+		// nodes on the output chain of a reported node have been reported too.
+		int32_t output_node = (nodes[node].output >= 0) ? node : nodes[node].outputLink;
+		for (; (output_node >= 0) && (nodes[output_node].generation != set_struct->generation);
+			 output_node = nodes[output_node].outputLink) {
+			nodes[output_node].generation = set_struct->generation;
+			for (int32_t pattern = nodes[output_node].output; pattern >= 0; pattern = set_struct->sameLiteral[pattern]) {
+				candidates[pattern] = true;
+				remaining--;
+			}
+		}
+	}
+}
+
+CFIndex TXRegexSetMatchString(TXRegexSetRef set, CFStringRef text, Boolean *matched, CFRange *ranges, UErrorCode *status)
+{
+	static const UChar empty[] = {0};
+	TXRegexSetStruct *set_struct = (TXRegexSetStruct *)CFDataGetBytePtr(set);
+	UniChar *uchars = NULL;
+	CFIndex length = 0;
+	CFStringRef text_retained = CFStringRetainAndGetUTF16Ptr(text, &uchars, &length);
+	if (!text_retained) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return 0;
+	}
+	for (CFIndex n = 0; n < set_struct->count; n++) {
+		matched[n] = !set_struct->hasLiteral[n];
+		if (ranges) ranges[n] = CFRangeMake(kCFNotFound, 0);
+	}
+	TXRegexSetFindLiterals(set_struct, uchars, length, matched);
+	
+	CFIndex match_count = 0;
+	CFIndex n = 0;
+	for (; n < set_struct->count; n++) {
+		if (!matched[n]) continue;
+		TXRegexStruct *regexp_struct = TXRegexGetStruct(set_struct->regexps[n]);
+		URegularExpression *re = regexp_struct->uregexp;
+		uregex_setText(re, uchars, (int32_t)length, status);
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		matched[n] = uregex_find(re, 0, status);
+		TXRegexStatisticsRecordSearch(regexp_struct, start_time, matched[n], *status);
+		if (matched[n] && ranges) {
+			int32_t start = uregex_start(re, 0, status);
+			ranges[n] = CFRangeMake(start, uregex_end(re, 0, status) - start);
+		}
+		uregex_setText(re, empty, 0, status);
+		if (U_ZERO_ERROR != *status) break;
+		if (matched[n]) match_count++;
+	}
+	// after an error, the patterns not searched may still be marked by the literal prefilter.
+	for (; n < set_struct->count; n++) {
+		matched[n] = false;
+		if (ranges) ranges[n] = CFRangeMake(kCFNotFound, 0);
+	}
+	CFRelease(text_retained);
+	return match_count;
+}
+
+#pragma mark replacement
+
+#define kTXRegexOutputChunkLength 4096
+
+/*
+ Characters are collected into a buffer. Without a destination the buffer grows to hold the whole
+ result. With a destination the buffer is a fixed chunk flushed to the destination when it is full.
+ */
+typedef struct TXRegexOutput {
+	UniChar *characters;
+	CFIndex length;
+	CFIndex capacity;
+	CFMutableStringRef destination;
+	Boolean failed; // failed to allocate memory
+	TXRegexStruct *regexpStruct; // to record growths of the buffer. NULL if not recorded.
+} TXRegexOutput;
+
+static Boolean TXRegexOutputInit(TXRegexOutput *output, CFIndex capacity, CFMutableStringRef destination)
+{
+	if (destination) capacity = kTXRegexOutputChunkLength;
+	else if (capacity < 16) capacity = 16;
+	output->characters = malloc(capacity * sizeof(UniChar));
+	output->length = 0;
+	output->capacity = capacity;
+	output->destination = destination;
+	output->regexpStruct = NULL;
+	output->failed = (NULL == output->characters);
+	return !output->failed;
+}
+
+static void TXRegexOutputFlush(TXRegexOutput *output)
+{
+	if (output->destination && output->length) {
+		CFStringAppendCharacters(output->destination, output->characters, output->length);
+		output->length = 0;
+	}
+}
+
+// Make room for length characters. Returns false when length does not fit into the chunk of a destination.
+static Boolean TXRegexOutputReserve(TXRegexOutput *output, CFIndex length)
+{
+	if (output->length + length <= output->capacity) return true;
+	if (output->destination) {
+		TXRegexOutputFlush(output);
+		return (length <= output->capacity);
+	}
+	CFIndex capacity = output->capacity;
+	while (output->length + length > capacity) capacity *= 2;
+	UniChar *buffer = realloc(output->characters, capacity * sizeof(UniChar));
+	if (!buffer) {
+		output->failed = true;
+		return false;
+	}
+	output->characters = buffer;
+	output->capacity = capacity;
+	if (output->regexpStruct && TXRegexStatisticsIsEnabled()) {
+		TXRegexStatisticsAdd(output->regexpStruct, outputGrowths, 1);
+	}
+	return true;
+}
+
+static Boolean TXRegexOutputAppend(TXRegexOutput *output, const UniChar *characters, CFIndex length)
+{
+	if (!TXRegexOutputReserve(output, length)) {
+		if (output->failed) return false;
+		CFStringAppendCharacters(output->destination, characters, length);
+		return true;
+	}
+	memcpy(output->characters + output->length, characters, length * sizeof(UniChar));
+	output->length += length;
+	return true;
+}
+
+Boolean TXRegexOutputAppendCharacters(TXRegexOutputRef output, const UniChar *characters, CFIndex length)
+{
+	return TXRegexOutputAppend(output, characters, length);
+}
+
+Boolean TXRegexOutputAppendString(TXRegexOutputRef output, CFStringRef string)
+{
+	CFIndex length = CFStringGetLength(string);
+	const UniChar *characters = CFStringGetCharactersPtr(string);
+	if (characters) return TXRegexOutputAppend(output, characters, length);
+	if (!TXRegexOutputReserve(output, length)) {
+		if (output->failed) return false;
+		CFStringAppend(output->destination, string);
+		return true;
+	}
+	CFStringGetCharacters(string, CFRangeMake(0, length), output->characters + output->length);
+	output->length += length;
+	return true;
+}
+
+// The buffer is owned by the result.
+static CFStringRef TXRegexOutputCreateString(TXRegexOutput *output)
+{
+	CFStringRef result = CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, output->characters,
+															output->length, kCFAllocatorMalloc);
+	if (!result) free(output->characters);
+	output->characters = NULL;
+	return result;
+}
+
+static void TXRegexOutputDestroy(TXRegexOutput *output)
+{
+	TXRegexOutputFlush(output);
+	free(output->characters);
+	output->characters = NULL;
+}
+
+/*
+ A replacement template is parsed into items, each of which is a run of literal characters
+ or a captured group. The syntax is the same as uregex_replaceAll : $n, ${name} and escapes with '\'.
+ */
+typedef struct {
+	CFIndex group; // -1 for literal characters
+	CFIndex location; // in the literal characters
+	CFIndex length;
+} TXRegexTemplateItem;
+
+typedef struct {
+	TXRegexTemplateItem *items;
+	CFIndex count;
+	UniChar *literals;
+} TXRegexTemplate;
+
+static void TXRegexTemplateDestroy(TXRegexTemplate *template)
+{
+	free(template->items);
+	free(template->literals);
+	template->items = NULL;
+	template->literals = NULL;
+}
+
+static void TXRegexTemplateAddLiteral(TXRegexTemplate *template, CFIndex *literalLength, UniChar c)
+{
+	TXRegexTemplateItem *last = template->count ? &template->items[template->count-1] : NULL;
+	if (!last || (last->group >= 0)) {
+		last = &template->items[template->count++];
+		last->group = -1;
+		last->location = *literalLength;
+		last->length = 0;
+	}
+	template->literals[(*literalLength)++] = c;
+	last->length++;
+}
+
+static CFIndex HexDigitValue(UniChar c)
+{
+	if (('0' <= c) && (c <= '9')) return c - '0';
+	if (('a' <= c) && (c <= 'f')) return c - 'a' + 10;
+	if (('A' <= c) && (c <= 'F')) return c - 'A' + 10;
+	return -1;
+}
+
+static Boolean TXRegexTemplateInit(TXRegexTemplate *template, URegularExpression *re,
+								   const UniChar *uchars, CFIndex length, UErrorCode *status)
+{
+	template->count = 0;
+	// every character makes at most one item and one literal character.
+	template->items = malloc((length + 1) * sizeof(TXRegexTemplateItem));
+	template->literals = malloc((length + 1) * sizeof(UniChar));
+	if (!template->items || !template->literals) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	CFIndex group_count = uregex_groupCount(re, status);
+	if (U_ZERO_ERROR != *status) goto bail;
+	
+	CFIndex literal_length = 0;
+	CFIndex n = 0;
+	while (n < length) {
+		UniChar c = uchars[n++];
+		if ('\\' == c) {
+			if (n >= length) break;
+			c = uchars[n++];
+			CFIndex digits = ('u' == c) ? 4 : (('U' == c) ? 8 : 0);
+			if (digits && (n + digits <= length)) {
+				UTF32Char code_point = 0;
+				CFIndex k = 0;
+				for (; (k < digits) && (HexDigitValue(uchars[n+k]) >= 0); k++) {
+					code_point = code_point*16 + (UTF32Char)HexDigitValue(uchars[n+k]);
+				}
+				if ((k == digits) && (code_point <= 0x10FFFF)) {
+					n += digits;
+					if (code_point > 0xFFFF) {
+						code_point -= 0x10000;
+						TXRegexTemplateAddLiteral(template, &literal_length, (UniChar)(0xD800 + (code_point >> 10)));
+						c = (UniChar)(0xDC00 + (code_point & 0x3FF));
+					} else {
+						c = (UniChar)code_point;
+					}
+				}
+			}
+			TXRegexTemplateAddLiteral(template, &literal_length, c);
+			continue;
+		}
+		if ('$' != c) {
+			TXRegexTemplateAddLiteral(template, &literal_length, c);
+			continue;
+		}
+		
+		CFIndex group = 0;
+		if ((n < length) && ('{' == uchars[n])) {
+			CFIndex name_start = ++n;
+			while ((n < length) && ('}' != uchars[n])) n++;
+			if ((n >= length) || (n == name_start)) {
+				*status = U_REGEX_INVALID_CAPTURE_GROUP_NAME;
+				goto bail;
+			}
+			group = uregex_groupNumberFromName(re, uchars + name_start, (int32_t)(n - name_start), status);
+			if (U_ZERO_ERROR != *status) goto bail;
+			n++;
+		} else {
+			// same as ICU, decimal digits are taken while the group number does not exceed the group count.
+			CFIndex digits = 0;
+			while (n < length) {
+				UChar32 digit = uchars[n];
+				CFIndex digit_length = 1;
+				if ((0xD800 == (digit & 0xFC00)) && (n+1 < length) && (0xDC00 == (uchars[n+1] & 0xFC00))) {
+					digit = 0x10000 + ((digit - 0xD800) << 10) + (uchars[n+1] - 0xDC00);
+					digit_length = 2;
+				}
+				if (!u_isdigit(digit)) break;
+				CFIndex value = u_charDigitValue(digit);
+				if (group*10 + value > group_count) {
+					if (!digits) {
+						*status = U_INDEX_OUTOFBOUNDS_ERROR;
+						goto bail;
+					}
+					break;
+				}
+				group = group*10 + value;
+				n += digit_length;
+				digits++;
+			}
+			if (!digits) {
+				*status = U_REGEX_INVALID_CAPTURE_GROUP_NAME;
+				goto bail;
+			}
+		}
+		TXRegexTemplateItem *item = &template->items[template->count++];
+		item->group = group;
+		item->location = 0;
+		item->length = 0;
+	}
+	return true;
+bail:
+	TXRegexTemplateDestroy(template);
+	return false;
+}
+
+/*
+ Append the target string with replacing matches to output in one pass of matching.
+ The target must be a string set by TXRegexSetString. The template is parsed at the first match,
+ so that an invalid template is not an error without matches, same as uregex_replaceAll.
+ */
+static CFIndex TXRegexAppendReplacingMatches(TXRegexStruct *regexp_struct, CFStringRef replacement,
+											 Boolean replaceAll, TXRegexOutput *output, UErrorCode *status)
+{
+	URegularExpression *re = regexp_struct->uregexp;
+	int32_t length = 0;
+	const UniChar *uchars = uregex_getText(re, &length, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	output->regexpStruct = regexp_struct;
+	
+	CFStringRef replacement_retained = NULL;
+	TXRegexTemplate template = {NULL, 0, NULL};
+	CFIndex count = 0;
+	int64_t last_end = 0;
+	UBool found = TXRegexFind(regexp_struct, 0, status);
+	while (found && (U_ZERO_ERROR == *status)) {
+		if (!template.items) {
+			UniChar *replacement_chars = NULL;
+			CFIndex replacement_len = 0;
+			replacement_retained = CFStringRetainAndGetUTF16Ptr(replacement, &replacement_chars, &replacement_len);
+			if (!replacement_retained) {
+				*status = U_MEMORY_ALLOCATION_ERROR;
+				goto bail;
+			}
+			if (!TXRegexTemplateInit(&template, re, replacement_chars, replacement_len, status)) goto bail;
+		}
+		int64_t start = uregex_start64(re, 0, status);
+		int64_t end = uregex_end64(re, 0, status);
+		if (U_ZERO_ERROR != *status) goto bail;
+		if (!TXRegexOutputAppend(output, uchars + last_end, (CFIndex)(start - last_end))) goto nomemory;
+		for (CFIndex n = 0; n < template.count; n++) {
+			TXRegexTemplateItem *item = &template.items[n];
+			if (item->group < 0) {
+				if (!TXRegexOutputAppend(output, template.literals + item->location, item->length)) goto nomemory;
+				continue;
+			}
+			int64_t group_start = uregex_start64(re, (int32_t)item->group, status);
+			int64_t group_end = uregex_end64(re, (int32_t)item->group, status);
+			if (U_ZERO_ERROR != *status) goto bail;
+			if (group_start < 0) continue; // the group did not participate in the match.
+			if (!TXRegexOutputAppend(output, uchars + group_start, (CFIndex)(group_end - group_start))) goto nomemory;
+		}
+		last_end = end;
+		count++;
+		if (!replaceAll) break;
+		found = TXRegexFindNext(regexp_struct, status);
+	}
+	if (U_ZERO_ERROR != *status) goto bail;
+	if (!TXRegexOutputAppend(output, uchars + last_end, (CFIndex)(length - last_end))) goto nomemory;
+	
+	SafeRelease(replacement_retained);
+	TXRegexTemplateDestroy(&template);
+	return count;
+nomemory:
+	*status = U_MEMORY_ALLOCATION_ERROR;
+bail:
+	SafeRelease(replacement_retained);
+	TXRegexTemplateDestroy(&template);
+	return 0;
+}
+
+static CFStringRef CFStringCreateByReplacingMatches(CFStringRef text, TXRegexRef regexp, CFStringRef replacement,
+													Boolean replaceAll, UErrorCode *status)
+{
+	CFIndex target_len = TXRegexSetString(regexp, text, status);
+	if (!target_len) return NULL;
+	if (U_ZERO_ERROR != *status) return NULL;
+	
+	TXRegexOutput output;
+	if (!TXRegexOutputInit(&output, target_len + CFStringGetLength(replacement), NULL)) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	TXRegexAppendReplacingMatches(regexp_struct, replacement, replaceAll, &output, status);
+	if (U_ZERO_ERROR != *status) {
+		TXRegexOutputDestroy(&output);
+		return NULL;
+	}
+	return TXRegexOutputCreateString(&output);
+}
+
+#pragma mark split fields
+
+typedef struct {
+	CFRange *ranges;
+	CFIndex capacity;
+	CFIndex count;
+	Boolean growable; // ranges is reallocated instead of dropping fields beyond capacity.
+} TXRegexFieldRanges;
+
+static Boolean TXRegexFieldRangesAdd(TXRegexFieldRanges *fields, CFIndex location, CFIndex length)
+{
+	if ((fields->count >= fields->capacity) && fields->growable) {
+		CFIndex capacity = fields->capacity ? fields->capacity*2 : 64;
+		CFRange *ranges = realloc(fields->ranges, capacity * sizeof(CFRange));
+		if (!ranges) return false;
+		fields->ranges = ranges;
+		fields->capacity = capacity;
+	}
+	if (fields->count < fields->capacity) fields->ranges[fields->count] = CFRangeMake(location, length);
+	fields->count++;
+	return true;
+}
+
+/*
+ Obtain ranges of fields separated by matches, same as CFStringCreateArrayByRegexSplitting.
+ Matching stops after maxSplit matches, and the rest of the text is the last field.
+ */
+static void TXRegexSplitRanges(TXRegexStruct *regexp_struct, CFIndex length, CFIndex maxSplit,
+							   TXRegexFieldRanges *fields, UErrorCode *status)
+{
+	URegularExpression *re = regexp_struct->uregexp;
+	CFIndex preend = 0;
+	if (regexp_struct->regionStart >= 0) {
+		// only the region is split.
+		preend = (CFIndex)regexp_struct->regionStart;
+		length = (CFIndex)regexp_struct->regionLimit;
+	}
+	CFIndex splits = 0;
+	while (((maxSplit <= 0) || (splits < maxSplit)) && TXRegexFindNext(regexp_struct, status)) {
+		int64_t start = uregex_start64(re, 0, status);
+		int64_t end = uregex_end64(re, 0, status);
+		if (U_ZERO_ERROR != *status) return;
+		if (!TXRegexFieldRangesAdd(fields, preend, (CFIndex)start - preend)) goto nomemory;
+		preend = (CFIndex)end;
+		splits++;
+	}
+	if (U_ZERO_ERROR != *status) return;
+	if ((length > preend) && !TXRegexFieldRangesAdd(fields, preend, length - preend)) goto nomemory;
+	return;
+nomemory:
+	*status = U_MEMORY_ALLOCATION_ERROR;
+}
+
+typedef struct {
+	CFStringRef text;
+	CFRange *ranges;
+	CFIndex count;
+	CFStringRef *fields; // materialized fields. allocated at the first access.
+} TXRegexSplitStruct;
+
+static void TXRegexSplitDeallocate(void *ptr, void *info)
+{
+	TXRegexSplitStruct *split_struct = (TXRegexSplitStruct *)ptr;
+	if (split_struct->fields) {
+		for (CFIndex n = 0; n < split_struct->count; n++) {
+			SafeRelease(split_struct->fields[n]);
+		}
+	}
+	free(split_struct->fields);
+	free(split_struct->ranges);
+	SafeRelease(split_struct->text);
+	free(split_struct);
+}
+
+static CFAllocatorRef CreateTXRegexSplitDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexSplitDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+#define TXRegexSplitGetStruct(x) ((TXRegexSplitStruct *)CFDataGetBytePtr(x))
+
+TXRegexSplitRef TXRegexSplitCreate(CFAllocatorRef allocator, CFStringRef text, TXRegexRef regexp,
+								   CFIndex maxSplit, UErrorCode *status)
+{
+	CFIndex length = TXRegexSetString(regexp, text, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	TXRegexFieldRanges fields = {NULL, 0, 0, true};
+	if (length) TXRegexSplitRanges(regexp_struct, length, maxSplit, &fields, status); // an empty text has no fields.
+	TXRegexSplitStruct *split_struct = NULL;
+	if (U_ZERO_ERROR != *status) goto bail;
+	
+	split_struct = malloc(sizeof(TXRegexSplitStruct));
+	if (!split_struct) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	split_struct->text = CFStringCreateCopy(kCFAllocatorDefault, text);
+	split_struct->ranges = fields.ranges;
+	split_struct->count = fields.count;
+	split_struct->fields = NULL;
+	return CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)split_struct,
+									   sizeof(TXRegexSplitStruct), CreateTXRegexSplitDeallocator());
+bail:
+	free(fields.ranges);
+	return NULL;
+}
+
+CFIndex TXRegexSplitGetCount(TXRegexSplitRef split)
+{
+	return TXRegexSplitGetStruct(split)->count;
+}
+
+CFRange TXRegexSplitGetRangeAtIndex(TXRegexSplitRef split, CFIndex index)
+{
+	return TXRegexSplitGetStruct(split)->ranges[index];
+}
+
+CFStringRef TXRegexSplitGetFieldAtIndex(TXRegexSplitRef split, CFIndex index)
+{
+	TXRegexSplitStruct *split_struct = TXRegexSplitGetStruct(split);
+	CFStringRef *fields = __atomic_load_n(&split_struct->fields, __ATOMIC_ACQUIRE);
+	if (!fields) {
+		CFStringRef *new_fields = calloc(split_struct->count, sizeof(CFStringRef));
+		if (!new_fields) return NULL;
+		// another thread may have made the array meanwhile.
+		if (__atomic_compare_exchange_n(&split_struct->fields, &fields, new_fields,
+										false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			fields = new_fields;
+		} else {
+			free(new_fields);
+		}
+	}
+	CFStringRef field = __atomic_load_n(&fields[index], __ATOMIC_ACQUIRE);
+	if (field) return field;
+	
+	// fields are made at the first access.
+	CFRange range = split_struct->ranges[index];
+	field = range.length ? CFStringCreateWithSubstring(CFGetAllocator(split), split_struct->text, range) : CFRetain(CFSTR(""));
+	if (!field) return NULL;
+	CFStringRef expected = NULL;
+	if (!__atomic_compare_exchange_n(&fields[index], &expected, field,
+									 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		CFRelease(field);
+		field = expected;
+	}
+	return field;
+}
+
+#pragma mark incremental matching
+
+typedef struct {
+	TXRegexRef regexp; // retained for the limits and the match callback.
+	URegularExpression *uregexp; // a clone searching chars.
+	CFStringRef text;
+	UniChar *chars; // a copy of text, edited along with text by TXRegexMatchIndexUpdate.
+	CFIndex length;
+	CFIndex charsCapacity;
+	CFIndex maxMatchLength;
+	CFIndex gcount;
+	CFRange *ranges; // gcount ranges of each match.
+	CFIndex count;
+	CFIndex capacity; // in ranges.
+	CFRange *found; // ranges of the matches searched again by an update.
+	CFIndex foundCapacity;
+	Boolean complete; // false after an error, so that the next update searches the whole text.
+} TXRegexMatchIndexStruct;
+
+#define TXRegexMatchIndexGetStruct(x) ((TXRegexMatchIndexStruct *)CFDataGetBytePtr(x))
+
+static void TXRegexMatchIndexDeallocate(void *ptr, void *info)
+{
+	TXRegexMatchIndexStruct *index_struct = (TXRegexMatchIndexStruct *)ptr;
+	if (index_struct->uregexp) uregex_close(index_struct->uregexp);
+	SafeRelease(index_struct->regexp);
+	SafeRelease(index_struct->text);
+	free(index_struct->chars);
+	free(index_struct->ranges);
+	free(index_struct->found);
+	free(index_struct);
+}
+
+static CFAllocatorRef CreateTXRegexMatchIndexDeallocator(void) {
+    static CFAllocatorRef allocator = NULL;
+    if (!allocator) {
+        CFAllocatorContext context =
+		{0, // version
+			NULL, //info
+			NULL, // retain callback
+			(void *)free,  //  CFAllocatorReleaseCallBack
+			NULL, // CFAllocatorCopyDescriptionCallBack
+		NULL, //CFAllocatorAllocateCallBack
+		NULL, // CFAllocatorReallocateCallBack 
+		TXRegexMatchIndexDeallocate, //CFAllocatorDeallocateCallBack 
+		NULL //CFAllocatorPreferredSizeCallBack 
+		};
+        allocator = CFAllocatorCreate(NULL, &context);
+    }
+    return allocator;
+}
+
+static Boolean TXRegexMatchIndexReserve(CFRange **ranges, CFIndex *capacity, CFIndex required)
+{
+	if (required <= *capacity) return true;
+	CFIndex new_capacity = *capacity ? *capacity : 64;
+	while (new_capacity < required) new_capacity *= 2;
+	CFRange *new_ranges = realloc(*ranges, new_capacity * sizeof(CFRange));
+	if (!new_ranges) return false;
+	*ranges = new_ranges;
+	*capacity = new_capacity;
+	return true;
+}
+
+// the index of the first match starting at or after location.
+static CFIndex TXRegexMatchIndexLowerBound(TXRegexMatchIndexStruct *index_struct, CFIndex location)
+{
+	CFIndex low = 0;
+	CFIndex high = index_struct->count;
+	while (low < high) {
+		CFIndex middle = low + (high - low) / 2;
+		if (index_struct->ranges[middle * index_struct->gcount].location < location) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// move position back to the start of a surrogate pair, where ICU can start a match attempt.
+static CFIndex TXRegexMatchIndexCodePointStart(const UniChar *chars, CFIndex length, CFIndex position)
+{
+	if ((position > 0) && (position < length) && (0xDC00 == (chars[position] & 0xFC00))
+		&& (0xD800 == (chars[position-1] & 0xFC00))) return position - 1;
+	return position;
+}
+
+/*
+ Whether the search before the edit passed old_position, the position of the search after the
+ edit in the offsets before the edit. A position inside a previous match was skipped.
+ */
+static Boolean TXRegexMatchIndexPassedPosition(TXRegexMatchIndexStruct *index_struct, CFIndex next, CFIndex old_position)
+{
+	if (0 == next) return true;
+	CFRange previous = index_struct->ranges[(next - 1) * index_struct->gcount];
+	CFIndex previous_end = previous.location + previous.length;
+	return (previous_end < old_position) || ((previous_end == old_position) && previous.length);
+}
+
+/*
+ Search again after characters of range were replaced with replacementLength characters.
+ Match attempts before range.location - maxMatchLength did not see the edit, so the matches
+ there are kept and the search restarts after them. A match attempt at or after the end of the
+ replacement + maxMatchLength sees the same characters as before the edit, so the search stops
+ there when the search before the edit passed the same position, and the previous matches after
+ it are shifted. Each search is bounded by a window, so that a search far beyond the edit is not
+ run before the positions are compared.
+ */
+static CFRange TXRegexMatchIndexSearch(TXRegexMatchIndexStruct *index_struct, CFRange range, CFIndex replacementLength,
+									   UErrorCode *status)
+{
+	URegularExpression *re = index_struct->uregexp;
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(index_struct->regexp);
+	CFIndex gcount = index_struct->gcount;
+	CFIndex length = index_struct->length;
+	CFIndex max_length = index_struct->maxMatchLength;
+	CFIndex delta = replacementLength - range.length;
+	CFIndex kept = 0;
+	CFIndex old_count = index_struct->count;
+	CFIndex position = 0;
+	CFIndex sync_position = range.location + replacementLength + max_length;
+	// a match starting before window is not affected by the limit of the region searched.
+	CFIndex window = TXRegexMatchIndexCodePointStart(index_struct->chars, length, sync_position);
+	CFIndex window_length = max_length;
+	if (index_struct->complete) {
+		kept = TXRegexMatchIndexLowerBound(index_struct, range.location - max_length + 1);
+		if (range.location - max_length > position) {
+			position = TXRegexMatchIndexCodePointStart(index_struct->chars, length, range.location - max_length);
+		}
+	} else {
+		old_count = 0; // the previous matches are not reliable.
+		window = length + 1;
+	}
+	if (kept) {
+		CFRange last = index_struct->ranges[(kept - 1) * gcount];
+		CFIndex after = TXRegexPositionAfterMatch(index_struct->chars, (int32_t)length, (int32_t)last.location,
+												  (int32_t)(last.location + last.length));
+		if (after > position) position = after;
+	}
+	CFIndex next = kept; // the first previous match which may follow the matches found again.
+	CFIndex found_count = 0;
+	Boolean synchronized = false;
+	uregex_setText(re, index_struct->chars, (int32_t)length, status);
+	while (U_ZERO_ERROR == *status) {
+		if (index_struct->complete && (position >= sync_position)) {
+			CFIndex old_position = position - delta;
+			while ((next < old_count) && (index_struct->ranges[next * gcount].location < old_position)) next++;
+			if (TXRegexMatchIndexPassedPosition(index_struct, next, old_position)) {
+				synchronized = true;
+				break;
+			}
+		}
+		if (position >= window) {
+			window_length *= 2;
+			window = TXRegexMatchIndexCodePointStart(index_struct->chars, length, position + window_length);
+		}
+		CFIndex limit = (window < length - max_length) ? window + max_length : length;
+		if (position > limit) break; // after an empty match at the end.
+		uregex_setRegionAndStart(re, 0, limit, position, status);
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		UBool found = uregex_findNext(re, status);
+		TXRegexStatisticsRecordSearch(regexp_struct, start_time, found, *status);
+		if (U_ZERO_ERROR != *status) break;
+		if (found && (limit < length) && (uregex_start(re, 0, status) >= window)) found = false;
+		if (!found) {
+			if (limit == length) break;
+			position = window; // no match starts before window.
+			continue;
+		}
+		if (!TXRegexMatchIndexReserve(&index_struct->found, &index_struct->foundCapacity, (found_count + 1) * gcount)) {
+			*status = U_MEMORY_ALLOCATION_ERROR;
+			break;
+		}
+		CFRange *ranges = index_struct->found + found_count * gcount;
+		for (int32_t g = 0; g < gcount; g++) {
+			int32_t start = uregex_start(re, g, status);
+			int32_t end = uregex_end(re, g, status);
+			ranges[g] = (start < 0) ? CFRangeMake(kCFNotFound, 0) : CFRangeMake(start, end - start);
+		}
+		found_count++;
+		position = TXRegexPositionAfterMatch(index_struct->chars, (int32_t)length, (int32_t)ranges[0].location,
+											 (int32_t)(ranges[0].location + ranges[0].length));
+	}
+	if (U_ZERO_ERROR != *status) goto bail;
+	
+	// kept matches, the matches found again and the shifted previous matches, in this order.
+	if (!synchronized) next = old_count;
+	CFIndex tail_count = old_count - next;
+	CFIndex count = kept + found_count + tail_count;
+	if (!TXRegexMatchIndexReserve(&index_struct->ranges, &index_struct->capacity, count * gcount)) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	CFRange *tail = index_struct->ranges + (kept + found_count) * gcount;
+	// ranges and found are NULL until the first match is kept or found.
+	if (tail_count) memmove(tail, index_struct->ranges + next * gcount, tail_count * gcount * sizeof(CFRange));
+	for (CFIndex n = 0; n < tail_count * gcount; n++) {
+		if (kCFNotFound != tail[n].location) tail[n].location += delta;
+	}
+	if (found_count) memcpy(index_struct->ranges + kept * gcount, index_struct->found, found_count * gcount * sizeof(CFRange));
+	index_struct->count = count;
+	index_struct->complete = true;
+	return CFRangeMake(kept, found_count);
+bail:
+	index_struct->count = 0;
+	index_struct->complete = false;
+	return CFRangeMake(0, 0);
+}
+
+TXRegexMatchIndexRef TXRegexMatchIndexCreate(CFAllocatorRef allocator, TXRegexRef regexp, CFStringRef text,
+											 CFIndex maxMatchLength, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	TXRegexMatchIndexStruct *index_struct = calloc(1, sizeof(TXRegexMatchIndexStruct));
+	if (!index_struct) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	index_struct->regexp = CFRetain(regexp);
+	index_struct->text = CFRetain(text);
+	index_struct->maxMatchLength = (maxMatchLength < 1) ? 1 : maxMatchLength;
+	index_struct->length = CFStringGetLength(text);
+	index_struct->charsCapacity = index_struct->length ? index_struct->length : 1;
+	index_struct->chars = malloc(index_struct->charsCapacity * sizeof(UniChar));
+	if (!index_struct->chars) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	CFStringGetCharacters(text, CFRangeMake(0, index_struct->length), index_struct->chars);
+	index_struct->uregexp = uregex_clone(regexp_struct->uregexp, status);
+	if (U_ZERO_ERROR != *status) goto bail;
+	TXRegexApplyLimits(regexp_struct, index_struct->uregexp, status);
+	// searches are bounded by regions, which must not change the matches.
+	uregex_useTransparentBounds(index_struct->uregexp, true, status);
+	uregex_useAnchoringBounds(index_struct->uregexp, false, status);
+	index_struct->gcount = uregex_groupCount(index_struct->uregexp, status) + 1;
+	if (U_ZERO_ERROR != *status) goto bail;
+	TXRegexMatchIndexSearch(index_struct, CFRangeMake(0, 0), 0, status);
+	if (U_ZERO_ERROR != *status) goto bail;
+	return CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)index_struct,
+									   sizeof(TXRegexMatchIndexStruct), CreateTXRegexMatchIndexDeallocator());
+bail:
+	TXRegexMatchIndexDeallocate(index_struct, NULL);
+	return NULL;
+}
+
+CFRange TXRegexMatchIndexUpdate(TXRegexMatchIndexRef index, CFRange range, CFIndex replacementLength, UErrorCode *status)
+{
+	TXRegexMatchIndexStruct *index_struct = TXRegexMatchIndexGetStruct(index);
+	CFIndex length = CFStringGetLength(index_struct->text);
+	if ((range.location < 0) || (range.length < 0) || (replacementLength < 0)
+		|| (range.location + range.length > index_struct->length)
+		|| (length != index_struct->length - range.length + replacementLength)) {
+		*status = U_ILLEGAL_ARGUMENT_ERROR;
+		return CFRangeMake(0, 0);
+	}
+	if (length > index_struct->charsCapacity) {
+		CFIndex capacity = (length < index_struct->charsCapacity * 2) ? index_struct->charsCapacity * 2 : length;
+		UniChar *chars = realloc(index_struct->chars, capacity * sizeof(UniChar));
+		if (!chars) {
+			*status = U_MEMORY_ALLOCATION_ERROR;
+			return CFRangeMake(0, 0);
+		}
+		index_struct->chars = chars;
+		index_struct->charsCapacity = capacity;
+	}
+	CFIndex old_end = range.location + range.length;
+	memmove(index_struct->chars + range.location + replacementLength, index_struct->chars + old_end,
+			(index_struct->length - old_end) * sizeof(UniChar));
+	CFStringGetCharacters(index_struct->text, CFRangeMake(range.location, replacementLength),
+						  index_struct->chars + range.location);
+	index_struct->length = length;
+	return TXRegexMatchIndexSearch(index_struct, range, replacementLength, status);
+}
+
+CFIndex TXRegexMatchIndexGetCount(TXRegexMatchIndexRef index)
+{
+	return TXRegexMatchIndexGetStruct(index)->count;
+}
+
+CFIndex TXRegexMatchIndexGetGroupCount(TXRegexMatchIndexRef index)
+{
+	return TXRegexMatchIndexGetStruct(index)->gcount;
+}
+
+CFRange TXRegexMatchIndexGetRangeAtIndex(TXRegexMatchIndexRef index, CFIndex matchIndex, CFIndex group)
 {
-	if (!regexp) return;
-	uregex_close(regexp->uregexp);
-	SafeRelease(regexp->targetString);
-	free(regexp);
+	TXRegexMatchIndexStruct *index_struct = TXRegexMatchIndexGetStruct(index);
+	return index_struct->ranges[matchIndex * index_struct->gcount + group];
 }
-*/
 
-static void TXRegexDeallocate(void *ptr, void *info)
+CFRange TXRegexMatchIndexGetMatchesInRange(TXRegexMatchIndexRef index, CFRange range)
 {
-#if useLog
-	fputs("TXRegexDeallocate\n", stderr);
-#endif		
-	TXRegexStruct *regexp = (TXRegexStruct *)ptr;
-	uregex_close(regexp->uregexp);
-	SafeRelease(regexp->targetString);
-	free(regexp);
+	TXRegexMatchIndexStruct *index_struct = TXRegexMatchIndexGetStruct(index);
+	CFIndex first = TXRegexMatchIndexLowerBound(index_struct, range.location);
+	CFIndex end = TXRegexMatchIndexLowerBound(index_struct, range.location + range.length);
+	return CFRangeMake(first, end - first);
 }
 
-char *austrdup(const UChar* unichars)
+#pragma mark pattern archives
 
+/*
+ An archive is a header, a table of entries and a pool of UTF-16 characters, in this order.
+ Patterns are kept as text because ICU has no serialized form of a compiled pattern.
+ */
+#define kTXRegexArchiveMagic 0x41525854 // "TXRA" in little endian
+#define kTXRegexArchiveVersion 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t characterCount; // the length of the character pool
+} TXRegexArchiveHeader;
+
+typedef struct {
+	uint32_t options;
+	uint32_t patternLocation; // in the character pool
+	uint32_t patternLength;
+	uint32_t literalLocation;
+	uint32_t literalLength; // 0 when no literal is required.
+	uint32_t literalIsPrefix;
+} TXRegexArchiveEntry;
+
+CFDataRef TXRegexArchiveCreateData(CFAllocatorRef allocator, CFArrayRef regexps, UErrorCode *status)
 {
-    int   length;
-    char *newString;
-	
-    length    = u_strlen ( unichars );
-    newString = (char*)malloc ( sizeof( char ) * 4 * ( length + 1 ) );
-    if ( newString == NULL )
-        return NULL;
+	CFIndex count = CFArrayGetCount(regexps);
+	CFIndex character_count = 0;
+	for (CFIndex n = 0; n < count; n++) {
+		TXRegexStruct *regexp_struct = TXRegexGetStruct((TXRegexRef)CFArrayGetValueAtIndex(regexps, n));
+		int32_t length = 0;
+		uregex_pattern(regexp_struct->uregexp, &length, status);
+		if (U_ZERO_ERROR != *status) return NULL;
+		character_count += length + regexp_struct->literalLength;
+	}
+	if (character_count > UINT32_MAX) {
+		*status = U_INDEX_OUTOFBOUNDS_ERROR;
+		return NULL;
+	}
 	
-    u_austrcpy ( newString, unichars );
+	CFIndex table_size = sizeof(TXRegexArchiveHeader) + count * sizeof(TXRegexArchiveEntry);
+	CFMutableDataRef data = CFDataCreateMutable(allocator, 0);
+	if (!data) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	CFDataSetLength(data, table_size + character_count * sizeof(UniChar));
+	UInt8 *bytes = CFDataGetMutableBytePtr(data);
+	TXRegexArchiveHeader *header = (TXRegexArchiveHeader *)bytes;
+	TXRegexArchiveEntry *entries = (TXRegexArchiveEntry *)(bytes + sizeof(TXRegexArchiveHeader));
+	UniChar *characters = (UniChar *)(bytes + table_size);
+	header->magic = kTXRegexArchiveMagic;
+	header->version = kTXRegexArchiveVersion;
+	header->count = (uint32_t)count;
+	header->characterCount = (uint32_t)character_count;
 	
-    return newString;
+	uint32_t location = 0;
+	for (CFIndex n = 0; n < count; n++) {
+		TXRegexStruct *regexp_struct = TXRegexGetStruct((TXRegexRef)CFArrayGetValueAtIndex(regexps, n));
+		int32_t length = 0;
+		const UChar *pattern = uregex_pattern(regexp_struct->uregexp, &length, status);
+		TXRegexArchiveEntry *entry = &entries[n];
+		entry->options = (uint32_t)uregex_flags(regexp_struct->uregexp, status);
+		if (U_ZERO_ERROR != *status) goto bail;
+		entry->patternLocation = location;
+		entry->patternLength = (uint32_t)length;
+		memcpy(characters + location, pattern, length * sizeof(UniChar));
+		location += (uint32_t)length;
+		entry->literalLocation = location;
+		entry->literalLength = (uint32_t)regexp_struct->literalLength;
+		entry->literalIsPrefix = regexp_struct->literalIsPrefix;
+		if (regexp_struct->literalLength) {
+			// literalChars is NULL for a pattern without a required literal.
+			memcpy(characters + location, regexp_struct->literalChars, regexp_struct->literalLength * sizeof(UniChar));
+		}
+		location += (uint32_t)regexp_struct->literalLength;
+	}
+	return data;
+bail:
+	CFRelease(data);
+	return NULL;
 }
 
-void fprintParseError(FILE *stream, UParseError *parse_error)
+Boolean TXRegexArchiveWriteFile(CFArrayRef regexps, const char *path, UErrorCode *status)
 {
-	char *post_context = austrdup(parse_error->postContext);
-	char *pre_context = austrdup(parse_error->preContext);
-	fprintf(stream ,"line : %d, offset : %d, precontext : %s, postcontext : %s\n",
-			parse_error->line, parse_error->offset, pre_context, post_context);
-	free(post_context);
-	free(pre_context);
+	CFDataRef data = TXRegexArchiveCreateData(kCFAllocatorDefault, regexps, status);
+	if (!data) return false;
+	Boolean result = false;
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		*status = U_FILE_ACCESS_ERROR;
+		goto bail;
+	}
+	const UInt8 *bytes = CFDataGetBytePtr(data);
+	CFIndex rest = CFDataGetLength(data);
+	while (rest > 0) {
+		ssize_t written = write(fd, bytes, rest);
+		if (written < 0) {
+			if (EINTR == errno) continue;
+			*status = U_FILE_ACCESS_ERROR;
+			break;
+		}
+		bytes += written;
+		rest -= written;
+	}
+	if ((close(fd) < 0) && (U_ZERO_ERROR == *status)) *status = U_FILE_ACCESS_ERROR;
+	result = (U_ZERO_ERROR == *status);
+bail:
+	CFRelease(data);
+	return result;
 }
 
-CFStringRef CFStringCreateWithFormattingParseError(UParseError *parse_error)
+typedef struct {
+	CFDataRef data;
+	const TXRegexArchiveEntry *entries;
+	const UniChar *characters;
+	CFIndex count;
+	TXRegexRef *regexps; // compiled at the first access.
+} TXRegexArchiveStruct;
+
+static void TXRegexArchiveDeallocate(void *ptr, void *info)
 {
-    char *post_context = austrdup(parse_error->postContext);
-	char *pre_context = austrdup(parse_error->preContext);
-    CFStringRef result = CFStringCreateWithFormat(kCFAllocatorDefault, NULL,
-								CFSTR("line : %d, offset : %d, precontext : %s, postcontext : %s\n"),
-								parse_error->line, parse_error->offset, pre_context, post_context);
-    free(post_context);
-	free(pre_context);
-    return result;
+	TXRegexArchiveStruct *archive_struct = (TXRegexArchiveStruct *)ptr;
+	for (CFIndex n = 0; n < archive_struct->count; n++) {
+		SafeRelease(archive_struct->regexps[n]);
+	}
+	free(archive_struct->regexps);
+	SafeRelease(archive_struct->data);
+	free(archive_struct);
 }
 
-static CFAllocatorRef CreateTXRegexDeallocator(void) {
+static CFAllocatorRef CreateTXRegexArchiveDeallocator(void) {
     static CFAllocatorRef allocator = NULL;
     if (!allocator) {
         CFAllocatorContext context =
@@ -214,7 +4330,7 @@ static CFAllocatorRef CreateTXRegexDeallocator(void) {
 			NULL, // CFAllocatorCopyDescriptionCallBack
 		NULL, //CFAllocatorAllocateCallBack
 		NULL, // CFAllocatorReallocateCallBack 
-		TXRegexDeallocate, //CFAllocatorDeallocateCallBack 
+		TXRegexArchiveDeallocate, //CFAllocatorDeallocateCallBack 
 		NULL //CFAllocatorPreferredSizeCallBack 
 		};
         allocator = CFAllocatorCreate(NULL, &context);
@@ -222,146 +4338,388 @@ static CFAllocatorRef CreateTXRegexDeallocator(void) {
     return allocator;
 }
 
-TXRegexRef TXRegexCreate(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status)
-{
-	TXRegexStruct *regexp_struct = malloc(sizeof(TXRegexStruct));
-	if (!regexp_struct) return NULL;
+#define TXRegexArchiveGetStruct(x) ((TXRegexArchiveStruct *)CFDataGetBytePtr(x))
 
-	regexp_struct->targetString = NULL;
+TXRegexArchiveRef TXRegexArchiveCreate(CFAllocatorRef allocator, CFDataRef data, UErrorCode *status)
+{
+	const UInt8 *bytes = CFDataGetBytePtr(data);
+	CFIndex length = CFDataGetLength(data);
+	if ((uintptr_t)bytes % sizeof(uint32_t)) {
+		// the table is read in place, so it must be aligned.
+		data = CFDataCreate(kCFAllocatorDefault, bytes, length);
+		bytes = CFDataGetBytePtr(data);
+	} else {
+		CFRetain(data);
+	}
+	const TXRegexArchiveHeader *header = (const TXRegexArchiveHeader *)bytes;
+	const TXRegexArchiveEntry *entries = (const TXRegexArchiveEntry *)(bytes + sizeof(TXRegexArchiveHeader));
+	TXRegexArchiveStruct *archive_struct = NULL;
+	if ((length < (CFIndex)sizeof(TXRegexArchiveHeader))
+		|| (kTXRegexArchiveMagic != header->magic) || (kTXRegexArchiveVersion != header->version)) goto invalid;
+	CFIndex table_size = sizeof(TXRegexArchiveHeader) + (CFIndex)header->count * sizeof(TXRegexArchiveEntry);
+	if (length != table_size + (CFIndex)header->characterCount * (CFIndex)sizeof(UniChar)) goto invalid;
+	// only the table is checked here. the patterns are checked by ICU when compiled.
+	for (uint32_t n = 0; n < header->count; n++) {
+		const TXRegexArchiveEntry *entry = &entries[n];
+		if (((uint64_t)entry->patternLocation + entry->patternLength > header->characterCount)
+			|| ((uint64_t)entry->literalLocation + entry->literalLength > header->characterCount)
+			|| (entry->patternLength > INT32_MAX)) goto invalid;
+	}
+	
+	archive_struct = malloc(sizeof(TXRegexArchiveStruct));
+	if (!archive_struct) goto nomemory;
+	archive_struct->regexps = calloc(header->count ? header->count : 1, sizeof(TXRegexRef));
+	if (!archive_struct->regexps) goto nomemory;
+	archive_struct->data = data;
+	archive_struct->entries = entries;
+	archive_struct->characters = (const UniChar *)(bytes + table_size);
+	archive_struct->count = header->count;
+	return CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)archive_struct,
+									   sizeof(TXRegexArchiveStruct), CreateTXRegexArchiveDeallocator());
+invalid:
+	*status = U_INVALID_FORMAT_ERROR;
+	goto bail;
+nomemory:
+	*status = U_MEMORY_ALLOCATION_ERROR;
+bail:
+	if (archive_struct) free(archive_struct->regexps);
+	free(archive_struct);
+	CFRelease(data);
+	return NULL;
+}
 
-	UniChar *uchars = NULL;
-	CFIndex length;
-	CFStringRef pattern_retained = CFStringRetainAndGetUTF16Ptr(pattern, &uchars, &length);
-	if (!pattern_retained) {
-		free(regexp_struct);
+TXRegexArchiveRef TXRegexArchiveCreateWithFile(CFAllocatorRef allocator, const char *path, UErrorCode *status)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		*status = U_FILE_ACCESS_ERROR;
 		return NULL;
 	}
-		
-	regexp_struct->uregexp = uregex_open(uchars, (int32_t)length, options, parse_error, status);
-	
-	CFRelease(pattern_retained);
-	CFAllocatorRef deallocator = CreateTXRegexDeallocator();
-	TXRegexRef regexp = CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)regexp_struct, 
-															  sizeof(TXRegexStruct), deallocator);
-	return regexp;
+	TXRegexArchiveRef archive = NULL;
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) < 0) {
+		*status = U_FILE_ACCESS_ERROR;
+		goto bail;
+	}
+	if (0 == file_stat.st_size) {
+		*status = U_INVALID_FORMAT_ERROR;
+		goto bail;
+	}
+	void *mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED == mapped) {
+		*status = U_FILE_ACCESS_ERROR;
+		goto bail;
+	}
+	CFAllocatorRef deallocator = CreateMappedFileDeallocator(file_stat.st_size);
+	CFDataRef data = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault, mapped, file_stat.st_size, deallocator);
+	CFRelease(deallocator);
+	archive = TXRegexArchiveCreate(allocator, data, status);
+	CFRelease(data);
+bail:
+	close(fd);
+	return archive;
 }
 
-TXRegexRef TXRegexCreateCopy(CFAllocatorRef allocator, TXRegexRef regexp, UErrorCode *status)
+CFIndex TXRegexArchiveGetCount(TXRegexArchiveRef archive)
 {
-#if useLog
-	fputs("TXRegexCreateCopy\n", stderr);
-#endif	
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	URegularExpression *new_uregexp = uregex_clone(regexp_struct->uregexp, status);
-	if (U_ZERO_ERROR != *status) return NULL;
-	
+	return TXRegexArchiveGetStruct(archive)->count;
+}
+
+TXRegexRef TXRegexArchiveGetRegexAtIndex(TXRegexArchiveRef archive, CFIndex index,
+										 UParseError *parse_error, UErrorCode *status)
+{
+	TXRegexArchiveStruct *archive_struct = TXRegexArchiveGetStruct(archive);
+	if ((index < 0) || (index >= archive_struct->count)) {
+		*status = U_INDEX_OUTOFBOUNDS_ERROR;
+		return NULL;
+	}
+	TXRegexRef regexp = __atomic_load_n(&archive_struct->regexps[index], __ATOMIC_ACQUIRE);
+	if (regexp) return regexp;
 	
-	TXRegexStruct *new_regexp_struct = malloc(sizeof(TXRegexStruct));
-	if (!new_regexp_struct) return NULL;
-	new_regexp_struct->targetString = NULL;
-	CFAllocatorRef deallocator = CreateTXRegexDeallocator();
-	TXRegexRef new_regexp = CFDataCreateWithBytesNoCopy(allocator, (const UInt8 *)new_regexp_struct, 
-													sizeof(TXRegexStruct), deallocator);
-	new_regexp_struct->uregexp = new_uregexp;
+	const TXRegexArchiveEntry *entry = &archive_struct->entries[index];
+	uint64_t start_time = TXRegexNanoseconds();
+	URegularExpression *uregexp = uregex_open(archive_struct->characters + entry->patternLocation,
+											  (int32_t)entry->patternLength, entry->options, parse_error, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	regexp = TXRegexCreateWithURegularExpression(CFGetAllocator(archive), uregexp);
+	if (!regexp) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (entry->literalLength) {
+		// the literal is copied, since the regular expression may outlive the archive.
+		CFStringRef literal = CFStringCreateWithCharacters(kCFAllocatorDefault,
+								archive_struct->characters + entry->literalLocation, entry->literalLength);
+		TXRegexSetRequiredLiteral(regexp_struct, literal, entry->literalIsPrefix);
+		SafeRelease(literal);
+	}
+	TXRegexStatisticsSetCompileTime(regexp_struct, start_time);
 	
-	return new_regexp; 
+	// another thread may have compiled the same pattern meanwhile.
+	TXRegexRef expected = NULL;
+	if (!__atomic_compare_exchange_n(&archive_struct->regexps[index], &expected, regexp,
+									 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		CFRelease(regexp);
+		regexp = expected;
+	}
+	return regexp;
 }
 
+#pragma mark arena allocator
 
-CFStringRef TXRegexCopyPatternString(TXRegexRef regexp, UErrorCode *status)
+/*
+ An arena allocates from the current block by bumping used. Every allocation is preceded by its size
+ for reallocation. Blocks are freed only by TXRegexArenaReset and the release of the allocator.
+ */
+typedef struct TXRegexArenaBlock {
+	struct TXRegexArenaBlock *next; // an older block.
+	CFIndex capacity;
+	CFIndex used;
+} TXRegexArenaBlock;
+
+typedef struct {
+	pthread_mutex_t lock;
+	CFIndex blockSize;
+	TXRegexArenaBlock *current;
+	CFIndex allocatedSize;
+} TXRegexArena;
+
+#define TXRegexArenaAlign(x) (((x) + 15) & ~(CFIndex)15)
+#define kTXRegexArenaBlockHeaderSize TXRegexArenaAlign((CFIndex)sizeof(TXRegexArenaBlock))
+#define kTXRegexArenaSizeHeaderSize 16
+
+static char *TXRegexArenaBlockData(TXRegexArenaBlock *block)
 {
-	int32_t len;
-	const UChar *uchars = NULL;
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	uchars = uregex_pattern(regexp_struct->uregexp, &len, status);
-	if (U_ZERO_ERROR != *status) return NULL;
-	return CFStringCreateWithCharacters(kCFAllocatorDefault, uchars, len);
+	return (char *)block + kTXRegexArenaBlockHeaderSize;
 }
 
-CFStringRef TXRegexCopyTargetString(TXRegexRef regexp, UErrorCode *status)
+static TXRegexArenaBlock *TXRegexArenaAddBlock(TXRegexArena *arena, CFIndex capacity)
 {
-	int32_t len;
-	const UChar *uchars = NULL;
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	uchars = uregex_getText(regexp_struct->uregexp, &len, status);
-	if (U_ZERO_ERROR != *status) return NULL;
-	return CFStringCreateWithCharacters(kCFAllocatorDefault, uchars, len);
+	TXRegexArenaBlock *block = malloc(kTXRegexArenaBlockHeaderSize + capacity);
+	if (!block) return NULL;
+	block->capacity = capacity;
+	block->used = 0;
+	arena->allocatedSize += capacity;
+	return block;
 }
 
-CFArrayRef CFArrayCreateWithFirstMatch(TXRegexRef regexp, CFIndex startIndex, UErrorCode *status)
+// Whether ptr is the last allocation of the current block, which can be resized in place.
+static Boolean TXRegexArenaIsLast(TXRegexArena *arena, void *ptr, CFIndex size)
 {
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	if (!uregex_find(regexp_struct->uregexp, (int32_t)startIndex, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	return CFArrayCreateWithCapturedGroups(regexp, status);
+	TXRegexArenaBlock *block = arena->current;
+	return block && ((char *)ptr + TXRegexArenaAlign(size) == TXRegexArenaBlockData(block) + block->used);
 }
 
-CFArrayRef CFArrayCreateWithNextMatch(TXRegexRef regexp, UErrorCode *status)
+static void *TXRegexArenaAllocate(CFIndex size, CFOptionFlags hint, void *info)
 {
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	if (!uregex_findNext(regexp_struct->uregexp, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	return CFArrayCreateWithCapturedGroups(regexp, status);
+	TXRegexArena *arena = (TXRegexArena *)info;
+	CFIndex required = kTXRegexArenaSizeHeaderSize + TXRegexArenaAlign(size);
+	char *result = NULL;
+	pthread_mutex_lock(&arena->lock);
+	TXRegexArenaBlock *block = arena->current;
+	if (!block || (block->used + required > block->capacity)) {
+		if (required > arena->blockSize / 4) {
+			// a large allocation gets its own block, and the current block keeps being filled.
+			block = TXRegexArenaAddBlock(arena, required);
+			if (!block) goto bail;
+			if (arena->current) {
+				block->next = arena->current->next;
+				arena->current->next = block;
+			} else {
+				block->next = NULL;
+				arena->current = block;
+			}
+		} else {
+			block = TXRegexArenaAddBlock(arena, arena->blockSize);
+			if (!block) goto bail;
+			block->next = arena->current;
+			arena->current = block;
+		}
+	}
+	result = TXRegexArenaBlockData(block) + block->used;
+	block->used += required;
+	*(CFIndex *)result = size;
+	result += kTXRegexArenaSizeHeaderSize;
+bail:
+	pthread_mutex_unlock(&arena->lock);
+	return result;
 }
 
-CFArrayRef TXRegexFirstMatch(TXRegexRef regexp, CFIndex startIndex, UErrorCode *status)
+static void *TXRegexArenaReallocate(void *ptr, CFIndex newsize, CFOptionFlags hint, void *info)
 {
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	if (!uregex_find(regexp_struct->uregexp, (int32_t)startIndex, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	return TXRegexCapturedGroups(regexp, status);
+	TXRegexArena *arena = (TXRegexArena *)info;
+	CFIndex *size = (CFIndex *)((char *)ptr - kTXRegexArenaSizeHeaderSize);
+	CFIndex old_size = *size;
+	pthread_mutex_lock(&arena->lock);
+	if (TXRegexArenaIsLast(arena, ptr, old_size)) {
+		TXRegexArenaBlock *block = arena->current;
+		CFIndex used = block->used - TXRegexArenaAlign(old_size) + TXRegexArenaAlign(newsize);
+		if (used <= block->capacity) {
+			block->used = used;
+			*size = newsize;
+			pthread_mutex_unlock(&arena->lock);
+			return ptr;
+		}
+	}
+	pthread_mutex_unlock(&arena->lock);
+	void *result = TXRegexArenaAllocate(newsize, hint, info);
+	if (result) memcpy(result, ptr, (old_size < newsize) ? old_size : newsize);
+	return result;
 }
 
-CFArrayRef TXRegexNextMatch(TXRegexRef regexp, UErrorCode *status)
+// Only the last allocation is given back, so that temporary buffers are reused.
+static void TXRegexArenaDeallocate(void *ptr, void *info)
 {
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	if (!uregex_findNext(regexp_struct->uregexp, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	return TXRegexCapturedGroups(regexp, status);
+	TXRegexArena *arena = (TXRegexArena *)info;
+	CFIndex size = *(CFIndex *)((char *)ptr - kTXRegexArenaSizeHeaderSize);
+	pthread_mutex_lock(&arena->lock);
+	if (TXRegexArenaIsLast(arena, ptr, size)) {
+		arena->current->used -= kTXRegexArenaSizeHeaderSize + TXRegexArenaAlign(size);
+	}
+	pthread_mutex_unlock(&arena->lock);
 }
 
-CFArrayRef TXRegexFirstMatchInString(TXRegexRef regexp, CFStringRef text, CFIndex startIndex, UErrorCode *status)
+static void TXRegexArenaRelease(const void *info)
 {
-	if (!TXRegexSetString(regexp, text, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	return TXRegexFirstMatch(regexp, startIndex, status);
+	TXRegexArena *arena = (TXRegexArena *)info;
+	TXRegexArenaBlock *block = arena->current;
+	while (block) {
+		TXRegexArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+	pthread_mutex_destroy(&arena->lock);
+	free(arena);
 }
 
-CFArrayRef TXRegexAllMatchesInString(TXRegexRef regexp, CFStringRef text, UErrorCode *status)
+CFAllocatorRef TXRegexArenaCreate(CFIndex blockSize)
 {
-	if (!TXRegexSetString(regexp, text, status)) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
+	TXRegexArena *arena = malloc(sizeof(TXRegexArena));
+	if (!arena) return NULL;
+	pthread_mutex_init(&arena->lock, NULL);
+	arena->blockSize = (blockSize > 0) ? TXRegexArenaAlign(blockSize) : kTXRegexArenaDefaultBlockSize;
+	arena->current = NULL;
+	arena->allocatedSize = 0;
+	CFAllocatorContext context =
+	{0, // version
+		arena, // info
+		NULL, // retain callback
+		TXRegexArenaRelease, // CFAllocatorReleaseCallBack
+		NULL, // CFAllocatorCopyDescriptionCallBack
+		TXRegexArenaAllocate, // CFAllocatorAllocateCallBack
+		TXRegexArenaReallocate, // CFAllocatorReallocateCallBack
+		TXRegexArenaDeallocate, // CFAllocatorDeallocateCallBack
+		NULL // CFAllocatorPreferredSizeCallBack
+	};
+	CFAllocatorRef allocator = CFAllocatorCreate(NULL, &context);
+	if (!allocator) TXRegexArenaRelease(arena);
+	return allocator;
+}
 
-	CFMutableArrayRef matches = NULL;
-	matches = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+static TXRegexArena *TXRegexArenaGetStruct(CFAllocatorRef allocator)
+{
+	CFAllocatorContext context;
+	CFAllocatorGetContext(allocator, &context);
+	if (context.allocate != TXRegexArenaAllocate) return NULL;
+	return (TXRegexArena *)context.info;
+}
 
-	CFArrayRef a_match = NULL;
-	while ((a_match = TXRegexNextMatch(regexp, status))) {
-		if(U_ZERO_ERROR != *status) {
-			CFRelease(a_match);
-			break;
+static Boolean TXRegexAllocatorIsArena(CFAllocatorRef allocator)
+{
+	return TXRegexArenaGetStruct(allocator) != NULL;
+}
+
+void TXRegexArenaReset(CFAllocatorRef allocator)
+{
+	TXRegexArena *arena = TXRegexArenaGetStruct(allocator);
+	if (!arena) return;
+	pthread_mutex_lock(&arena->lock);
+	TXRegexArenaBlock *kept = NULL;
+	TXRegexArenaBlock *block = arena->current;
+	while (block) {
+		TXRegexArenaBlock *next = block->next;
+		if (!kept && (block->capacity == arena->blockSize)) {
+			kept = block;
+		} else {
+			arena->allocatedSize -= block->capacity;
+			free(block);
 		}
-		CFArrayAppendValue(matches, a_match);
-		CFRelease(a_match);		
+		block = next;
 	}
-	
-	return matches;
+	if (kept) {
+		kept->next = NULL;
+		kept->used = 0;
+	}
+	arena->current = kept;
+	pthread_mutex_unlock(&arena->lock);
+}
+
+CFIndex TXRegexArenaGetAllocatedSize(CFAllocatorRef allocator)
+{
+	TXRegexArena *arena = TXRegexArenaGetStruct(allocator);
+	if (!arena) return 0;
+	pthread_mutex_lock(&arena->lock);
+	CFIndex size = arena->allocatedSize;
+	pthread_mutex_unlock(&arena->lock);
+	return size;
 }
 
 #pragma mark additions to CFString
-Boolean CFStringIsMatchedWithRegex(CFStringRef text, TXRegexRef regexp, UErrorCode *status)
+static Boolean TXRegexIsMatched(CFStringRef text, TXRegexRef regexp, UErrorCode *status)
 {
 	Boolean result = false;
 	if (TXRegexSetString(regexp, text, status)) {
 		TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-		result = (Boolean)uregex_matches(regexp_struct->uregexp, 0, status);	
+		const UniChar *target = NULL;
+		int32_t length = 0;
+		if (TXRegexGetPatternLiteralTarget(regexp_struct, &target, &length, status)) {
+			// the whole target has to be the literal whichever anchors the pattern has.
+			uint64_t start_time = TXRegexStatisticsStartTime();
+			result = (length == regexp_struct->patternLiteralLength)
+						&& TXRegexPatternLiteralIsAt(regexp_struct, target, 0);
+			TXRegexStatisticsRecordSearch(regexp_struct, start_time, result, *status);
+			return result;
+		}
+		if (U_ZERO_ERROR != *status) return false;
+		Boolean has_region = (regexp_struct->regionStart >= 0);
+		if (regexp_struct->literalLength) {
+			UniChar *uchars = (UniChar *)uregex_getText(regexp_struct->uregexp, NULL, status);
+			CFIndex start = has_region ? (CFIndex)regexp_struct->regionStart : 0;
+			CFIndex limit = has_region ? (CFIndex)regexp_struct->regionLimit : CFStringGetLength(text);
+			if (kCFNotFound == TXRegexFindLiteral(uchars, limit, start,
+												  regexp_struct->literalChars, regexp_struct->literalLength)) {
+				if (TXRegexStatisticsIsEnabled()) TXRegexStatisticsAdd(regexp_struct, literalRejections, 1);
+				return false;
+			}
+		}
+		uint64_t start_time = TXRegexStatisticsStartTime();
+		// -1 matches the region, while 0 would reset it.
+		result = (Boolean)uregex_matches(regexp_struct->uregexp, has_region ? -1 : 0, status);
+		TXRegexStatisticsRecordSearch(regexp_struct, start_time, result, *status);
+	}
+	return result;
+}
+
+Boolean CFStringIsMatchedWithRegex(CFStringRef text, TXRegexRef regexp, UErrorCode *status)
+{
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	if (!TXRegexResultCacheIsUsable(regexp_struct, text)) return TXRegexIsMatched(text, regexp, status);
+	
+	CFHashCode hash = TXRegexHashString(text, kCFNotFound);
+	TXRegexResultEntry *entry = TXRegexResultCacheLookup(regexp_struct->resultCache, text, kCFNotFound, hash);
+	if (entry) {
+		TXRegexResetTarget(regexp_struct);
+		return entry->matched;
 	}
+	Boolean result = TXRegexIsMatched(text, regexp, status);
+	if (U_ZERO_ERROR == *status) TXRegexResultCacheAdd(regexp_struct, text, kCFNotFound, hash, result);
 	return result;
 }
 
 Boolean CFStringIsMatchedWithPattern(CFStringRef text, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status)
 {
-	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, pattern, options, parse_error, status);
+	TXRegexRef regexp = TXRegexCreateWithCache(kCFAllocatorDefault, pattern, options, parse_error, status);
 	if (!regexp) return false;
 	if (U_ZERO_ERROR != *status) {
 		CFRelease(regexp);
@@ -375,10 +4733,26 @@ Boolean CFStringIsMatchedWithPattern(CFStringRef text, CFStringRef pattern, uint
 
 CFArrayRef CFStringCreateArrayWithFirstMatch(CFStringRef text, TXRegexRef regexp, CFIndex startIndex, UErrorCode *status)
 {
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	Boolean use_cache = TXRegexResultCacheIsUsable(regexp_struct, text);
+	CFHashCode hash = 0;
+	if (use_cache) {
+		hash = TXRegexHashString(text, startIndex);
+		TXRegexResultEntry *entry = TXRegexResultCacheLookup(regexp_struct->resultCache, text, startIndex, hash);
+		if (entry) {
+			TXRegexResetTarget(regexp_struct);
+			if (!entry->matched) return NULL;
+			return TXRegexResultEntryCreateGroups(regexp_struct->resultAllocator, entry, text);
+		}
+	}
 	if (!TXRegexSetString(regexp, text, status)) return NULL;
 	if (U_ZERO_ERROR != *status) return NULL;
 	
-	return CFArrayCreateWithFirstMatch(regexp, startIndex, status);
+	CFArrayRef result = CFArrayCreateWithFirstMatch(regexp, startIndex, status);
+	if (use_cache && (U_ZERO_ERROR == *status)) {
+		TXRegexResultCacheAdd(regexp_struct, text, startIndex, hash, (result != NULL));
+	}
+	return result;
 }
 
 CFArrayRef CFStringCreateArrayWithAllMatches(CFStringRef text, TXRegexRef regexp, UErrorCode *status)
@@ -389,8 +4763,9 @@ CFArrayRef CFStringCreateArrayWithAllMatches(CFStringRef text, TXRegexRef regexp
 	TXRegexSetString(regexp, text, status);
 	if (U_ZERO_ERROR != *status) return NULL;
 
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
 	CFArrayRef groups = NULL;
-	CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+	CFMutableArrayRef array = CFArrayCreateMutable(regexp_struct->resultAllocator, 0, &kCFTypeArrayCallBacks);
 	while ((groups = CFArrayCreateWithNextMatch(regexp, status))) {
 		if (U_ZERO_ERROR != *status) {
 			CFRelease(groups);
@@ -405,109 +4780,115 @@ CFArrayRef CFStringCreateArrayWithAllMatches(CFStringRef text, TXRegexRef regexp
 
 CFArrayRef CFStringCreateArrayByRegexSplitting(CFStringRef text, TXRegexRef regexp, UErrorCode *status)
 {
-	if (!TXRegexSetString(regexp, text, status)) return NULL;
+	CFIndex length = TXRegexSetString(regexp, text, status);
+	if (!length) return NULL;
 	if (U_ZERO_ERROR != *status) return NULL;
-	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);	
-	URegularExpression *re = regexp_struct->uregexp;
-	CFIndex length = CFStringGetLength(text);
-	CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
-	
-	int32_t preend = 0;
-	int32_t start = 0;
-	int32_t end = 0;
-	CFStringRef substring = NULL;
-	while(uregex_findNext(re, status)) {		
-		start = uregex_start(re, 0, status);
-		if (start < 0) goto bail;
-		if (U_ZERO_ERROR != *status) goto bail;
-		
-		end = uregex_end(re, 0, status);
-		if (end < 0) goto bail;
-		if (U_ZERO_ERROR != *status) goto bail;
-		
-		if (start > preend) {
-			CFRange range = CFRangeMake(preend, start-preend);
-			substring = CFStringCreateWithSubstring(kCFAllocatorDefault, text, range);
-			CFArrayAppendValue(array, substring);
-			CFRelease(substring);
-		} else if (start == preend) {
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	TXRegexFieldRanges fields = {NULL, 0, 0, true};
+	TXRegexSplitRanges(regexp_struct, length, 0, &fields, status);
+	if (U_ZERO_ERROR != *status) {
+		free(fields.ranges);
+		return NULL;
+	}
+	
+	CFAllocatorRef allocator = regexp_struct->resultAllocator;
+	CFMutableArrayRef array = CFArrayCreateMutable(allocator, fields.count, &kCFTypeArrayCallBacks);
+	for (CFIndex n = 0; n < fields.count; n++) {
+		if (!fields.ranges[n].length) {
 			CFArrayAppendValue(array, CFSTR(""));
+			continue;
 		}
-		preend = end;
-	}
-	if (length > preend) {
-		CFRange range = CFRangeMake(preend, length-preend);
-		substring = CFStringCreateWithSubstring(kCFAllocatorDefault, text, range);
+		CFStringRef substring = CFStringCreateWithSubstring(allocator, text, fields.ranges[n]);
 		CFArrayAppendValue(array, substring);
-		CFRelease(substring);		
-	} 
-	
+		CFRelease(substring);
+	}
+	free(fields.ranges);
 	return array;
-bail:
-	CFRelease(array);
-	return NULL;
 }
 
-CFStringRef CFStringCreateByReplacingFirstMatch(CFStringRef text, TXRegexRef regexp, 
-												CFStringRef replacement, UErrorCode *status)
+CFIndex CFStringGetRangesByRegexSplitting(CFStringRef text, TXRegexRef regexp, CFRange *ranges, CFIndex capacity,
+										  CFIndex maxSplit, UErrorCode *status)
 {
-	CFIndex target_len = TXRegexSetString(regexp, text, status);
-	if (!target_len) return NULL;
-	if (U_ZERO_ERROR != *status) return NULL;
-	
-	UniChar *replacement_chars = NULL;
-	CFIndex replacement_len = 0;
-	CFStringRef replacement_retained = CFStringRetainAndGetUTF16Ptr(replacement,
-                                                                    &replacement_chars, &replacement_len);
-	if (!replacement_retained) return NULL;
-	
-	int32_t capacity = (int32_t)(target_len + replacement_len + 1);
-	UChar *buffer = malloc(capacity * sizeof(UChar));
+	CFIndex length = TXRegexSetString(regexp, text, status);
+	if (U_ZERO_ERROR != *status) return 0;
 	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	int32_t result_len = uregex_replaceFirst(regexp_struct->uregexp, replacement_chars,
-                                             (int32_t)replacement_len, buffer, capacity, status);
-	CFRelease(replacement_retained);
-	if (U_ZERO_ERROR != *status) {
-		free(buffer);
-		return NULL;
-	}
+	TXRegexFieldRanges fields = {ranges, capacity, 0, false};
+	if (length) TXRegexSplitRanges(regexp_struct, length, maxSplit, &fields, status);
+	if (U_ZERO_ERROR != *status) return 0;
+	return fields.count;
+}
 
-	return CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, buffer, result_len, kCFAllocatorMalloc);
+CFStringRef CFStringCreateByReplacingFirstMatch(CFStringRef text, TXRegexRef regexp, 
+												CFStringRef replacement, UErrorCode *status)
+{
+	return CFStringCreateByReplacingMatches(text, regexp, replacement, false, status);
 }
 
 CFStringRef CFStringCreateByReplacingAllMatches(CFStringRef text, TXRegexRef regexp, 
 												CFStringRef replacement, UErrorCode *status)
+{
+	return CFStringCreateByReplacingMatches(text, regexp, replacement, true, status);
+}
+
+CFIndex CFStringAppendByReplacingMatches(CFMutableStringRef string, CFStringRef text, TXRegexRef regexp,
+										 CFStringRef replacement, Boolean replaceAll, UErrorCode *status)
+{
+	if (!TXRegexSetString(regexp, text, status)) return 0;
+	if (U_ZERO_ERROR != *status) return 0;
+	
+	TXRegexOutput output;
+	if (!TXRegexOutputInit(&output, 0, string)) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		return 0;
+	}
+	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
+	CFIndex count = TXRegexAppendReplacingMatches(regexp_struct, replacement, replaceAll, &output, status);
+	TXRegexOutputDestroy(&output);
+	return count;
+}
+
+CFStringRef CFStringCreateByReplacingMatchesWithCallback(CFStringRef text, TXRegexRef regexp,
+														 TXRegexReplacementCallBack callback, void *info, UErrorCode *status)
 {
 	CFIndex target_len = TXRegexSetString(regexp, text, status);
 	if (!target_len) return NULL;
 	if (U_ZERO_ERROR != *status) return NULL;
 	TXRegexStruct *regexp_struct = TXRegexGetStruct(regexp);
-	URegularExpression *re = regexp_struct->uregexp;
-	UniChar *replacement_chars = NULL;
-	CFIndex replacement_len = 0;
-	CFStringRef replacement_retained = CFStringRetainAndGetUTF16Ptr(replacement,
-                                                                    &replacement_chars, &replacement_len);
-	if (!replacement_retained) return NULL;
-	
-	int32_t capacity = (int32_t)(target_len + replacement_len + 1);
-	UChar *buffer = malloc(capacity * sizeof(UChar));
-	int32_t result_len = uregex_replaceAll(re, replacement_chars, (int32_t)replacement_len,
-                                           buffer, capacity, status);
-	while ((U_BUFFER_OVERFLOW_ERROR == *status) || (U_STRING_NOT_TERMINATED_WARNING == *status)) {
-		*status = U_ZERO_ERROR;
-		uregex_reset(re, 0, status);
-		capacity = result_len+1; // to avoid U_STRING_NOT_TERMINATED_WARNING
-		buffer = reallocf(buffer, capacity*sizeof(UChar));
-		if (!buffer) break;
-		result_len = uregex_replaceAll(re, replacement_chars, (int32_t)replacement_len,
-                                       buffer, capacity, status);
-	}
-	
-	CFRelease(replacement_retained);
-	if (U_ZERO_ERROR != *status) {
-		free(buffer);
+	const UniChar *uchars = uregex_getText(regexp_struct->uregexp, NULL, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	CFIndex group_count = TXRegexGetGroupCount(regexp, status);
+	if (U_ZERO_ERROR != *status) return NULL;
+	
+	TXRegexOutput output;
+	CFRange *ranges = malloc(group_count * sizeof(CFRange));
+	if (!ranges || !TXRegexOutputInit(&output, target_len, NULL)) {
+		free(ranges);
+		*status = U_MEMORY_ALLOCATION_ERROR;
 		return NULL;
 	}
-	
-	return CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, buffer, result_len, kCFAllocatorMalloc);
+	output.regexpStruct = regexp_struct;
+	CFIndex last_end = 0;
+	UBool found = TXRegexFind(regexp_struct, 0, status);
+	while (found && (U_ZERO_ERROR == *status)) {
+		TXRegexGetMatchRanges(regexp_struct, ranges, group_count, status);
+		if (U_ZERO_ERROR != *status) goto bail;
+		TXRegexOutputAppend(&output, uchars + last_end, ranges[0].location - last_end);
+		last_end = ranges[0].location + ranges[0].length;
+		Boolean should_continue = callback(regexp, uchars, ranges, group_count, &output, info);
+		if (output.failed) break;
+		if (!should_continue) break;
+		found = TXRegexFindNext(regexp_struct, status);
+	}
+	if (U_ZERO_ERROR != *status) goto bail;
+	TXRegexOutputAppend(&output, uchars + last_end, target_len - last_end);
+	if (output.failed) {
+		*status = U_MEMORY_ALLOCATION_ERROR;
+		goto bail;
+	}
+	free(ranges);
+	return TXRegexOutputCreateString(&output);
+bail:
+	free(ranges);
+	TXRegexOutputDestroy(&output);
+	return NULL;
 }
@@ -26,6 +26,7 @@ typedef struct URegularExpression URegularExpression;
 
 typedef int8_t 	UBool;
 typedef uint16_t UChar;
+typedef int32_t UChar32;
 
 enum { U_PARSE_CONTEXT_LEN = 16 };
 
@@ -78,6 +79,10 @@ typedef enum URegexpFlag{
 	/**  Allow white space and comments within patterns  @stable ICU 2.4 */
 	UREGEX_COMMENTS         = 4,
 	
+	/**  The pattern is a literal string. Meta characters have no special meaning.
+	 *   @stable ICU 4.0 */
+	UREGEX_LITERAL          = 16,
+	
 	/**  If set, '.' matches line terminators,  otherwise '.' matching stops at line end.
 	 *  @stable ICU 2.4 */
 	UREGEX_DOTALL           = 32,
@@ -88,6 +93,13 @@ typedef enum URegexpFlag{
 	 *   @stable ICU 2.4 */
 	UREGEX_MULTILINE        = 8,
 	
+	/**   Unix-only line endings.
+	 *   When this mode is enabled, only \\u000a is recognized as a line ending
+	 *    in the behavior of ., ^, and $.
+	 *   @stable ICU 4.0
+	 */
+	UREGEX_UNIX_LINES       = 1,
+	
 	/**  Unicode word boundaries.
 	 *     If set, \b uses the Unicode TR 29 definition of word boundaries.
 	 *     Warning: Unicode word boundaries are quite different from
@@ -100,9 +112,119 @@ typedef enum URegexpFlag{
 
 #pragma mark TXRegex functions
 
+/*!
+ @enum TXRegexOffsetUnit
+ @abstract The unit of offsets reported for a UTF-8 target set by TXRegexSetUTF8Bytes or TXRegexSetFile.
+ @constant kTXRegexOffsetUTF16 Offsets in UTF-16 characters, same as offsets in a CFString.
+ @constant kTXRegexOffsetUTF8Bytes Offsets in bytes of the UTF-8 target.
+ */
+typedef enum {
+	kTXRegexOffsetUTF16 = 0,
+	kTXRegexOffsetUTF8Bytes = 1
+} TXRegexOffsetUnit;
+
+/*!
+ @enum TXRegexGroupMode
+ @abstract How strings of captured groups are made.
+ @constant kTXRegexGroupCopy Each group is copied out of ICU with uregex_group into a new buffer.
+ @constant kTXRegexGroupSubstring Each group is made from the target directly. A substring of the target string is made when the string provides a UTF-16 pointer, otherwise the characters are copied once from the buffer which was searched.
+ */
+typedef enum {
+	kTXRegexGroupCopy = 0,
+	kTXRegexGroupSubstring = 1
+} TXRegexGroupMode;
+
+/*!
+ @typedef TXRegexStatistics
+ @abstract Counters of a pattern. They are recorded only while enabled by TXRegexSetStatisticsEnabled, except compileNanoseconds.
+ @discussion A TXRegularExpression object shares its counters with its copies made by TXRegexCreateCopy, with the objects made from the same entry of the cache of compiled patterns, and with the matchers of a TXRegexPattern. Searches run on copies or on cloned matchers inside the library, such as by TXRegexMatchBatch, TXRegexAllMatchesInStringParallel and TXRegexAllMatchesAsync, are counted as well.
+ @field compileNanoseconds Time to compile the pattern. It is always recorded.
+ @field copiedTargets The number of target strings copied into UTF-16 buffers because their characters are not contiguous.
+ @field copiedBytes The number of bytes of the copied target strings.
+ @field searches The number of searches run by ICU.
+ @field matches The number of searches which found a match.
+ @field searchNanoseconds Time spent in ICU by the searches.
+ @field literalRejections The number of searches finished without ICU because the target lacks the required literal of the pattern.
+ @field outputGrowths The number of times output buffers of replacement were enlarged.
+ @field limitTrips The number of searches stopped by the time limit, the stack limit or the match callback.
+ */
+typedef struct {
+	CFIndex compileNanoseconds;
+	CFIndex copiedTargets;
+	CFIndex copiedBytes;
+	CFIndex searches;
+	CFIndex matches;
+	CFIndex searchNanoseconds;
+	CFIndex literalRejections;
+	CFIndex outputGrowths;
+	CFIndex limitTrips;
+} TXRegexStatistics;
+
+/*!
+ @enum TXRegexLiteralKind
+ @abstract The form of a pattern which is a literal, possibly anchored. Such a pattern is searched without ICU by TXRegexHasMatch, TXRegexCountMatches, CFStringIsMatchedWithRegex and TXRegexMatchBatch.
+ @constant kTXRegexNotLiteral The pattern is matched by ICU.
+ @constant kTXRegexLiteral A literal matching anywhere.
+ @constant kTXRegexPrefixLiteral A literal anchored with ^.
+ @constant kTXRegexSuffixLiteral A literal anchored with $, which matches also before a line terminator at the end.
+ @constant kTXRegexWholeLiteral A literal anchored with both ^ and $.
+ */
+typedef enum {
+	kTXRegexNotLiteral = 0,
+	kTXRegexLiteral,
+	kTXRegexPrefixLiteral,
+	kTXRegexSuffixLiteral,
+	kTXRegexWholeLiteral
+} TXRegexLiteralKind;
+
+/*!
+ @typedef TXRegexMatchCallback
+ @abstract A function called periodically while ICU runs a long search.
+ @param steps The number of steps of the match engine so far in the search.
+ @param info The pointer given to TXRegexSetMatchCallback.
+ @result false to stop the search with U_REGEX_STOPPED_BY_CALLER.
+ */
+typedef Boolean (*TXRegexMatchCallback)(int32_t steps, void *info);
+
+#define kTXRegexDefaultStackLimit 8000000
+
+#define kTXRegexInlineTargetLength 128
+#define kTXRegexTargetScratchKeepLength 65536
+
 typedef struct  {
 	URegularExpression *uregexp;
 	CFStringRef targetString;
+	CFDataRef targetBytes; // UTF-8 target set by TXRegexSetUTF8Bytes
+	TXRegexOffsetUnit offsetUnit;
+	TXRegexGroupMode groupMode;
+	int64_t anchorByteOffset; // a pair of offsets converted last time
+	int64_t anchorUTF16Offset;
+	CFStringRef requiredLiteral; // a string which every match contains. NULL when unknown.
+	const UniChar *literalChars;
+	CFIndex literalLength;
+	Boolean literalIsPrefix; // every match starts with requiredLiteral.
+	CFIndex searchStart; // where the next search starts when nothing is searched after the target is set. -1 after a search.
+	struct TXRegexStatisticsBlock *statistics; // shared by the copies of the pattern.
+	Boolean targetCopied; // the characters of targetString are copied into inlineTarget or targetScratch.
+	UniChar *targetScratch; // a buffer reused by TXRegexSetString for strings without a UTF-16 pointer.
+	CFIndex targetScratchCapacity;
+	UniChar inlineTarget[kTXRegexInlineTargetLength]; // used instead of targetScratch for short strings.
+	TXRegexLiteralKind literalKind;
+	UniChar *patternLiteral; // the literal of literalKind. lowercased when literalCaseless.
+	CFIndex patternLiteralLength;
+	Boolean literalCaseless; // ASCII letters of patternLiteral match both cases.
+	Boolean unixLines; // only '\n' is a line terminator for $.
+	int32_t timeLimit; // 0 for no limit.
+	int32_t stackLimit;
+	TXRegexMatchCallback matchCallback;
+	void *matchCallbackInfo;
+	CFRange region; // in the offset unit. the location is kCFNotFound without a region.
+	Boolean regionTransparentBounds;
+	Boolean regionAnchoringBounds;
+	int64_t regionStart; // native offsets of the region applied to the current target, or -1.
+	int64_t regionLimit;
+	struct TXRegexResultCache *resultCache; // NULL unless enabled by TXRegexSetResultCacheCapacity.
+	CFAllocatorRef resultAllocator; // of matches, groups and fields. retained. NULL for the default allocator.
 } TXRegexStruct;
 
 /*!
@@ -115,7 +237,8 @@ typedef CFDataRef TXRegexRef;
 /*!
  @function TXRegexCreate
  @abstract Create a TXRegularExpression object. 
- @param allocator The allocator to use to allocate memory for the new string. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @discussion When every match of the pattern must contain a literal string, a target string is scanned for the literal before searching with ICU, and a target without it is rejected immediately.
+ @param allocator The allocator to use to allocate memory for the new object and the matches, groups and fields made from it. Pass NULL or kCFAllocatorDefault to use the current default allocator. When an arena of TXRegexArenaCreate is passed, the object itself is allocated by the default allocator and only the results are allocated from the arena, same as TXRegexSetResultAllocator.
  @param pattern A string of a regular expression
  @param options options of regular expression.
  @param parse_error A pointer to UParseError to receive information about errors occurred during parsing.
@@ -128,15 +251,103 @@ TXRegexRef TXRegexCreate(CFAllocatorRef allocator, CFStringRef pattern, uint32_t
 /*!
  @function TXRegexCreateCopy
  @abstract Copy a TXRegularExpression object. 
+ @discussion The copy has the same settings as regexp: the offset unit, the group mode, the limits, the match callback, the region and the capacity of the result cache. The target is not copied.
+ @param allocator The allocator to use to allocate memory for the new object and its results, same as TXRegexCreate.
  @param regexp A TXRegularExpression object to copy.
  @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
  @result A reference to TXRegularExpression object.
  */
 TXRegexRef TXRegexCreateCopy(CFAllocatorRef allocator, TXRegexRef regexp, UErrorCode *status);
 
+/*!
+ @function TXRegexSetStatisticsEnabled
+ @abstract Enable or disable recording of TXRegexStatistics for all TXRegularExpression objects. Disabled by default.
+ @discussion While disabled, recording costs only a check of a flag. While enabled, searches are timed with a monotonic clock.
+ */
+void TXRegexSetStatisticsEnabled(Boolean enabled);
+
+/*!
+ @function TXRegexGetStatistics
+ @abstract Obtain counters recorded for the pattern of a TXRegularExpression object.
+ @discussion The counters can be read while another thread uses regexp. They include the searches run by the copies of regexp.
+ @param regexp A reference to TXRegularExpression object.
+ @param statistics A pointer to TXRegexStatistics to recive the counters.
+ */
+void TXRegexGetStatistics(TXRegexRef regexp, TXRegexStatistics *statistics);
+
+/*!
+ @function TXRegexResetStatistics
+ @abstract Set the counters of the pattern of a TXRegularExpression object to zero.
+ @discussion The counters are shared with the copies of regexp, which are reset as well.
+ @param regexp A reference to TXRegularExpression object.
+ */
+void TXRegexResetStatistics(TXRegexRef regexp);
+
+/*!
+ @typedef TXRegexCacheStatistics
+ @abstract Counters of the process-wide cache of compiled patterns used by TXRegexCreateWithCache.
+ */
+typedef struct {
+	CFIndex hits;
+	CFIndex misses;
+	CFIndex evictions;
+	CFIndex count;
+	CFIndex capacity;
+} TXRegexCacheStatistics;
+
+/*!
+ @function TXRegexCreateWithCache
+ @abstract Create a TXRegularExpression object from the process-wide cache of compiled patterns.
+ @discussion Compiled patterns are kept in a thread-safe LRU cache keyed by the pattern and options. The result is a private clone of the cached pattern, so the pattern is compiled only when it is not cached.
+ @param allocator The allocator to use to allocate memory for the new object and its results, same as TXRegexCreate.
+ @param pattern A string of a regular expression
+ @param options options of regular expression.
+ @param parse_error A pointer to UParseError to receive information about errors occurred during parsing.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to TXRegularExpression object. NULL is returned when failed.
+ */
+TXRegexRef TXRegexCreateWithCache(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status);
+
+/*!
+ @function TXRegexCacheSetCapacity
+ @abstract Set the maximum number of compiled patterns kept by TXRegexCreateWithCache. The default is 256. Pass 0 to disable caching.
+ */
+void TXRegexCacheSetCapacity(CFIndex capacity);
+
+/*!
+ @function TXRegexCacheRemoveAll
+ @abstract Discard all compiled patterns kept by TXRegexCreateWithCache.
+ */
+void TXRegexCacheRemoveAll(void);
+
+/*!
+ @function TXRegexCacheGetStatistics
+ @abstract Obtain hit, miss and eviction counters of the cache used by TXRegexCreateWithCache.
+ */
+void TXRegexCacheGetStatistics(TXRegexCacheStatistics *statistics);
+
+#define kTXRegexResultCacheMaxTextLength 4096
+
+/*!
+ @function TXRegexSetResultCacheCapacity
+ @abstract Keep results of CFStringIsMatchedWithRegex and CFStringCreateArrayWithFirstMatch for strings which are matched repeatedly, e.g. header values.
+ @discussion Results are kept in an LRU cache of regexp keyed by a hash of the UTF-16 characters of the string, and a hit is verified by comparing the string. A hit returns the result without searching, and the target string of regexp is released. Groups of a cached first match are made from the string with the kept offsets. Strings longer than kTXRegexResultCacheMaxTextLength and searches while a region is set by TXRegexSetRegion are not cached. The cache is disabled by default. A copy made by TXRegexCreateCopy has an empty cache of the same capacity.
+ @param regexp A TXRegularExpression object.
+ @param capacity The maximum number of results. Pass 0 to disable the cache and discard the results.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ */
+void TXRegexSetResultCacheCapacity(TXRegexRef regexp, CFIndex capacity, UErrorCode *status);
+
+/*!
+ @function TXRegexGetResultCacheStatistics
+ @abstract Obtain hit, miss and eviction counters of the result cache of regexp. All counters are 0 while the cache is disabled.
+ */
+void TXRegexGetResultCacheStatistics(TXRegexRef regexp, TXRegexCacheStatistics *statistics);
+
 /*!
  @function TXRegexSetString
  @abstract Set a taget string to TXRegularExpression object. 
+ @discussion When text does not provide a UTF-16 pointer, its characters are copied into a buffer owned by regexp and reused by later calls, so matching one TXRegularExpression object against many strings does not allocate for each string.
  @param regexp A TXRegularExpression object.
  @param text A string to match with the regular expression.
  @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
@@ -144,14 +355,662 @@ TXRegexRef TXRegexCreateCopy(CFAllocatorRef allocator, TXRegexRef regexp, UError
  */
 CFIndex TXRegexSetString(TXRegexRef regexp, CFStringRef text, UErrorCode *status);
 
+/*!
+ @function TXRegexSetUTF8Bytes
+ @abstract Set a UTF-8 target to TXRegularExpression object without converting it into UTF-16.
+ @discussion ICU matches the bytes directly. The offsets given to and reported by TXRegexFirstMatch, TXRegexFirstMatchRanges, TXRegexNextMatchRanges, TXRegexCapturedGroups and TXRegexCopySubstring are in the unit specified by TXRegexSetOffsetUnit. Offsets in UTF-16 characters are counted from the previous converted offset, so reading matches in order costs one pass over the bytes. The bytes must be valid UTF-8 to obtain UTF-16 offsets.
+ @param regexp A TXRegularExpression object.
+ @param bytes UTF-8 bytes to match with the regular expression. The data is retained and must not be modified.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result length of the target in bytes.
+ */
+CFIndex TXRegexSetUTF8Bytes(TXRegexRef regexp, CFDataRef bytes, UErrorCode *status);
+
+/*!
+ @function TXRegexSetFile
+ @abstract Map a UTF-8 file into memory and set it to TXRegularExpression object as the target.
+ @discussion Same as TXRegexSetUTF8Bytes with the mapped contents of the file. The file is unmapped when the target is replaced or the TXRegularExpression object is released.
+ @param regexp A TXRegularExpression object.
+ @param path A path of the file.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors. U_FILE_ACCESS_ERROR is returned when the file can not be mapped.
+ @result length of the file in bytes.
+ */
+CFIndex TXRegexSetFile(TXRegexRef regexp, const char *path, UErrorCode *status);
+
+/*!
+ @function TXRegexSetOffsetUnit
+ @abstract Set the unit of offsets for a UTF-8 target. The default is kTXRegexOffsetUTF16. Offsets for a CFString target are always in UTF-16 characters.
+ */
+void TXRegexSetOffsetUnit(TXRegexRef regexp, TXRegexOffsetUnit unit);
+
+/*!
+ @function TXRegexSetGroupMode
+ @abstract Set how TXRegexFirstMatch, TXRegexNextMatch and the functions based on them make strings of captured groups. The default is kTXRegexGroupCopy.
+ */
+void TXRegexSetGroupMode(TXRegexRef regexp, TXRegexGroupMode mode);
+
+/*!
+ @function TXRegexSetResultAllocator
+ @abstract Set the allocator of the arrays, dictionaries, numbers and strings of matches, groups and fields made from a TXRegularExpression object.
+ @discussion The default is the allocator given when regexp was created. Pass an arena of TXRegexArenaCreate to allocate the results from it while regexp stays valid across TXRegexArenaReset. The allocator is retained by regexp.
+ @param regexp A TXRegularExpression object.
+ @param allocator An allocator. Pass NULL to use the current default allocator.
+ */
+void TXRegexSetResultAllocator(TXRegexRef regexp, CFAllocatorRef allocator);
+
+/*!
+ @function TXRegexSetTimeLimit
+ @abstract Limit the time of a search, so that a pattern backtracking catastrophically can not occupy a thread.
+ @discussion The limit applies to each search of ICU, including searches of copies made by TXRegexCreateCopy and by the functions running on threads. A search over the limit fails with U_REGEX_TIME_OUT, which is recorded as limitTrips of TXRegexStatistics.
+ @param regexp A TXRegularExpression object.
+ @param limit The limit in steps of the match engine of ICU, which take about a millisecond each. 0 for no limit, the default.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ */
+void TXRegexSetTimeLimit(TXRegexRef regexp, int32_t limit, UErrorCode *status);
+
+/*!
+ @function TXRegexSetStackLimit
+ @abstract Limit the memory of the backtracking stack of a search.
+ @discussion A search over the limit fails with U_REGEX_STACK_OVERFLOW, which is recorded as limitTrips of TXRegexStatistics.
+ @param regexp A TXRegularExpression object.
+ @param limit The limit in bytes. 0 for no limit. The default is kTXRegexDefaultStackLimit.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ */
+void TXRegexSetStackLimit(TXRegexRef regexp, int32_t limit, UErrorCode *status);
+
+/*!
+ @function TXRegexSetMatchCallback
+ @abstract Set a function called periodically during long searches, which can stop the search.
+ @discussion A search stopped by the callback fails with U_REGEX_STOPPED_BY_CALLER, which is recorded as limitTrips of TXRegexStatistics. The callback may be called on the threads of TXRegexMatchBatch, TXRegexAllMatchesInStringParallel and TXRegexAllMatchesAsync.
+ @param regexp A TXRegularExpression object.
+ @param callback A function to call, or NULL to remove the callback.
+ @param info A pointer passed to callback.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ */
+void TXRegexSetMatchCallback(TXRegexRef regexp, TXRegexMatchCallback callback, void *info, UErrorCode *status);
+
+/*!
+ @function TXRegexSetRegion
+ @abstract Restrict searches to a range of the target without copying it.
+ @discussion The region is kept by regexp and applied to the current target and to every target set afterwards, clipped to the length of the target. Searches, the functions finding all matches, splitting, replacing, TXRegexMatchBatch and CFStringIsMatchedWithRegex see only the region. Splitting returns the fields inside the region, and replacing keeps the text outside the region as is. Offsets of matches are offsets in the whole target. TXRegexAllMatchesInStringParallel searches a region in one thread. Stream matching and pattern sets ignore the region.
+ @param regexp A TXRegularExpression object.
+ @param range The region in the unit of offsets of the target. Pass a range whose location is kCFNotFound to search whole targets again.
+ @param transparentBounds true to let look-ahead, look-behind and word boundaries see the text outside the region.
+ @param anchoringBounds true to let ^ and $ match at the bounds of the region.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ */
+void TXRegexSetRegion(TXRegexRef regexp, CFRange range, Boolean transparentBounds, Boolean anchoringBounds,
+					  UErrorCode *status);
+
 CFArrayRef TXRegexFirstMatchInString(TXRegexRef regexp, CFStringRef text, CFIndex startIndex, UErrorCode *status);
 CFArrayRef TXRegexNextMatch(TXRegexRef regexp, UErrorCode *status);
+
+/*!
+ @function TXRegexGetGroupCount
+ @abstract Obtain the number of ranges reported for a match, i.e. the number of capture groups plus one for the whole match.
+ @param regexp A TXRegularExpression object.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of CFRange elements needed to receive all groups of a match.
+ */
+CFIndex TXRegexGetGroupCount(TXRegexRef regexp, UErrorCode *status);
+
+/*!
+ @function TXRegexFirstMatchRanges
+ @abstract Find the first match from startIndex in the target string and store the ranges of captured groups without creating any objects.
+ @param regexp A TXRegularExpression object which a target string is set to.
+ @param startIndex the index of the beginning character of the range to process.
+ @param ranges A caller-owned buffer to receive the range of each group. {kCFNotFound, 0} is stored for a group which did not participate in the match.
+ @param capacity The number of elements of ranges.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of groups of the match. 0 is returned when no match is found. When the result is larger than capacity, only capacity ranges are stored.
+ */
+CFIndex TXRegexFirstMatchRanges(TXRegexRef regexp, CFIndex startIndex, CFRange *ranges, CFIndex capacity, UErrorCode *status);
+
+/*!
+ @function TXRegexNextMatchRanges
+ @abstract Find the next match in the target string and store the ranges of captured groups without creating any objects.
+ @discussion Shares the matching state with TXRegexNextMatch. Call TXRegexSetString before the first call.
+ @param regexp A TXRegularExpression object which a target string is set to.
+ @param ranges A caller-owned buffer to receive the range of each group. {kCFNotFound, 0} is stored for a group which did not participate in the match.
+ @param capacity The number of elements of ranges.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of groups of the match. 0 is returned when no more matches are found. When the result is larger than capacity, only capacity ranges are stored.
+ */
+CFIndex TXRegexNextMatchRanges(TXRegexRef regexp, CFRange *ranges, CFIndex capacity, UErrorCode *status);
+
+/*!
+ @function TXRegexCopySubstring
+ @abstract Create a string of a range obtained by TXRegexFirstMatchRanges or TXRegexNextMatchRanges.
+ @param regexp A TXRegularExpression object which a target string is set to.
+ @param range A range in the target string. An empty string is returned for {kCFNotFound, 0}.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A substring of the target string.
+ */
+CFStringRef TXRegexCopySubstring(TXRegexRef regexp, CFRange range, UErrorCode *status);
 CFArrayRef TXRegexAllMatchesInString(TXRegexRef regexp, CFStringRef text, UErrorCode *status);
+
+/*!
+ @function TXRegexHasMatch
+ @abstract Test whether a string contains a match of a regular expression.
+ @discussion Unlike CFStringIsMatchedWithRegex, a match does not have to cover the whole string. No captured groups are extracted and no objects are created.
+ @param regexp A TXRegularExpression object.
+ @param text A string to process.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result true when a match is found.
+ */
+Boolean TXRegexHasMatch(TXRegexRef regexp, CFStringRef text, UErrorCode *status);
+
+/*!
+ @function TXRegexCountMatches
+ @abstract Count matches of a regular expression in a string.
+ @discussion The matches are the same as TXRegexAllMatchesInString, but no captured groups are extracted and no objects are created.
+ @param regexp A TXRegularExpression object.
+ @param text A string to process.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of matches.
+ */
+CFIndex TXRegexCountMatches(TXRegexRef regexp, CFStringRef text, UErrorCode *status);
+
+/*!
+ @function TXRegexAllMatchesInStringParallel
+ @abstract Obtain all matches in a long string by searching chunks of the string on worker threads.
+ @discussion Each worker searches its chunk with a clone of the regular expression, looking maxMatchLength characters beyond the end of the chunk. The chunks are stitched so that the result is identical to TXRegexAllMatchesInString as long as no match is longer than maxMatchLength. Matches reaching the look-ahead window are searched again with a wider window. A string too short to be split is processed by TXRegexAllMatchesInString. Patterns using \G are not supported.
+ @param regexp A TXRegularExpression object.
+ @param text A string to process.
+ @param maxMatchLength The maximum length of a match. This is used as the overlap of chunks.
+ @param threadCount The number of worker threads. Pass 0 to use the number of active processors.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result An array of arrays of captured groups, same as TXRegexAllMatchesInString.
+ */
+CFArrayRef TXRegexAllMatchesInStringParallel(TXRegexRef regexp, CFStringRef text, CFIndex maxMatchLength,
+											 CFIndex threadCount, UErrorCode *status);
+
 CFStringRef TXRegexCopyPatternString(TXRegexRef regexp, UErrorCode *status);
 CFStringRef TXRegexCopyTargetString(TXRegexRef regexp, UErrorCode *status);
 
 void fprintParseError(FILE *stream, UParseError *parse_error);
 
+#pragma mark shared patterns
+/*!
+ @typedef TXRegexPatternRef
+ @abstract A reference to an immutable compiled pattern which can be shared by many threads.
+ @discussion A TXRegexPatternRef does not hold any matching state. Each thread checks out its own matcher with TXRegexPatternCheckOutMatcher and returns it with TXRegexPatternCheckInMatcher. Returned matchers are kept in a lock-free pool and reused, so the pattern is never compiled again.
+ */
+typedef CFDataRef TXRegexPatternRef;
+
+/*!
+ @function TXRegexPatternCreate
+ @abstract Create a shared compiled pattern.
+ @param allocator The allocator to use to allocate memory for the new object and the results of its matchers. Pass NULL or kCFAllocatorDefault to use the current default allocator. An arena of TXRegexArenaCreate is used only for the results, same as TXRegexCreate.
+ @param pattern A string of a regular expression
+ @param options options of regular expression.
+ @param parse_error A pointer to UParseError to receive information about errors occurred during parsing.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to a shared compiled pattern. NULL is returned when failed.
+ */
+TXRegexPatternRef TXRegexPatternCreate(CFAllocatorRef allocator, CFStringRef pattern, uint32_t options, UParseError *parse_error, UErrorCode *status);
+
+/*!
+ @function TXRegexPatternCreateWithRegex
+ @abstract Create a shared compiled pattern from a compiled pattern of a TXRegularExpression object.
+ @param allocator The allocator to use to allocate memory for the new object and the results of its matchers, same as TXRegexPatternCreate.
+ @param regexp A TXRegularExpression object. Its target string is not inherited.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to a shared compiled pattern. NULL is returned when failed.
+ */
+TXRegexPatternRef TXRegexPatternCreateWithRegex(CFAllocatorRef allocator, TXRegexRef regexp, UErrorCode *status);
+
+/*!
+ @function TXRegexPatternCheckOutMatcher
+ @abstract Obtain a TXRegularExpression object for exclusive use by the calling thread.
+ @discussion An idle matcher in the pool is reused. A new matcher is cloned from the compiled pattern only when the pool is empty. Pass the matcher to TXRegexPatternCheckInMatcher or CFRelease it when finished.
+ @param pattern A shared compiled pattern.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to TXRegularExpression object owned by the caller.
+ */
+TXRegexRef TXRegexPatternCheckOutMatcher(TXRegexPatternRef pattern, UErrorCode *status);
+
+/*!
+ @function TXRegexPatternCheckInMatcher
+ @abstract Return a matcher obtained by TXRegexPatternCheckOutMatcher to the pool.
+ @discussion The target string of the matcher is released, and the time limit, the stack limit, the match callback, the region and its bounds, the offset unit, the group mode and the capacity of the result cache are set back to those of the pattern. The caller must not use the matcher after this call. All matchers must be checked in or released before the pattern is released.
+ @param pattern The shared compiled pattern the matcher was checked out from.
+ @param regexp A matcher obtained by TXRegexPatternCheckOutMatcher.
+ */
+void TXRegexPatternCheckInMatcher(TXRegexPatternRef pattern, TXRegexRef regexp);
+
+#pragma mark batch matching
+/*!
+ @typedef TXRegexBatchResults
+ @abstract First matches of a regular expression in many strings, in flat arrays.
+ @field count The number of the strings.
+ @field groupCount The number of groups of a match including the whole match.
+ @field matched count flags telling whether each string matched.
+ @field matchCount The number of the matched strings.
+ @field indexes matchCount indexes of the matched strings in ascending order.
+ @field ranges matchCount * groupCount ranges of groups. The groups of the n-th matched string start at ranges[n * groupCount]. An unmatched group is {kCFNotFound, 0}.
+ */
+typedef struct {
+	CFIndex count;
+	CFIndex groupCount;
+	Boolean *matched;
+	CFIndex matchCount;
+	CFIndex *indexes;
+	CFRange *ranges;
+} TXRegexBatchResults;
+
+/*!
+ @typedef TXRegexBatchRef
+ @abstract A reference to results of TXRegexMatchBatch.
+ */
+typedef CFDataRef TXRegexBatchRef;
+
+/*!
+ @function TXRegexMatchBatch
+ @abstract Search the first match of a regular expression in each of many strings.
+ @discussion Worker threads take blocks of strings in turn, each with a clone of the regular expression. No object is made for each string, and a string without a UTF-16 pointer is copied into a buffer reused by the worker. The target string of regexp is released.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param regexp A TXRegularExpression object.
+ @param texts A C array of strings to process.
+ @param count The number of the strings.
+ @param threadCount The maximum number of worker threads. Pass 0 to use the number of active processors.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to results. NULL is returned when failed.
+ */
+TXRegexBatchRef TXRegexMatchBatch(CFAllocatorRef allocator, TXRegexRef regexp, const CFStringRef *texts, CFIndex count,
+								  CFIndex threadCount, UErrorCode *status);
+
+/*!
+ @function TXRegexMatchBatchWithArray
+ @abstract Same as TXRegexMatchBatch with strings in a CFArray.
+ */
+TXRegexBatchRef TXRegexMatchBatchWithArray(CFAllocatorRef allocator, TXRegexRef regexp, CFArrayRef texts,
+										   CFIndex threadCount, UErrorCode *status);
+
+/*!
+ @function TXRegexBatchGetResults
+ @abstract Obtain the results kept by batch.
+ @result A pointer to the results which is valid while batch is alive.
+ */
+const TXRegexBatchResults *TXRegexBatchGetResults(TXRegexBatchRef batch);
+
+#pragma mark asynchronous matching
+/*!
+ @typedef TXRegexJobRef
+ @abstract A reference to a search running on the internal thread pool.
+ */
+typedef CFDataRef TXRegexJobRef;
+
+/*!
+ @typedef TXRegexJobCallBack
+ @abstract A function called on a worker thread when a job finished, was cancelled or failed.
+ @param job The job, which is valid during the call even if the caller already released it.
+ @param matches The matches, same as TXRegexAllMatchesInString. NULL when status is not U_ZERO_ERROR. Retain it to use it after the call.
+ @param status U_ZERO_ERROR, U_REGEX_STOPPED_BY_CALLER for a cancelled job, or an error of the search.
+ @param info The pointer given to TXRegexAllMatchesAsync.
+ */
+typedef void (*TXRegexJobCallBack)(TXRegexJobRef job, CFArrayRef matches, UErrorCode status, void *info);
+
+/*!
+ @function TXRegexAllMatchesAsync
+ @abstract Obtain all matches in a string on a thread of an internal pool without blocking the caller.
+ @discussion The job searches with a copy of regexp made by TXRegexCreateCopy, so regexp can be used or released at once. The pool has a thread for each active processor, started at the first call. Each thread has a queue of jobs and takes jobs from the queues of the other threads when its own is empty. Completion is delivered to callback, and can also be polled with TXRegexJobIsFinished or waited for with TXRegexJobGetMatches.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator. The matches are allocated by the result allocator of regexp.
+ @param regexp A TXRegularExpression object. Its region, limits and match callback apply to the job.
+ @param text A string to process. An immutable copy is searched.
+ @param callback A function called when the job finished. May be NULL.
+ @param info A pointer passed to callback.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to the job owned by the caller. NULL is returned when failed, and callback is not called.
+ */
+TXRegexJobRef TXRegexAllMatchesAsync(CFAllocatorRef allocator, TXRegexRef regexp, CFStringRef text,
+									 TXRegexJobCallBack callback, void *info, UErrorCode *status);
+
+/*!
+ @function TXRegexJobCancel
+ @abstract Stop a job. A queued job is not searched, and a running search stops at the next match or at the next call of the match callback of ICU. The job finishes with U_REGEX_STOPPED_BY_CALLER unless it has already finished.
+ */
+void TXRegexJobCancel(TXRegexJobRef job);
+
+/*!
+ @function TXRegexJobIsFinished
+ @abstract Tell whether a job finished without blocking. The callback of the job may still be running.
+ */
+Boolean TXRegexJobIsFinished(TXRegexJobRef job);
+
+/*!
+ @function TXRegexJobGetMatches
+ @abstract Wait until a job finishes and obtain the matches.
+ @param job A reference to the job.
+ @param status A pointer to UErrorCode to recive the result of the job.
+ @result The matches, which are valid while job is alive. NULL when failed or cancelled.
+ */
+CFArrayRef TXRegexJobGetMatches(TXRegexJobRef job, UErrorCode *status);
+
+#pragma mark stream matching
+#define kTXRegexStreamDefaultWindowSize 65536
+#define kTXRegexStreamContextLength 256
+
+/*!
+ @typedef TXRegexStreamReadCallBack
+ @abstract A callback to supply UTF-16 characters to TXRegexScanStream.
+ @param buffer A buffer to store the characters.
+ @param capacity The number of characters which can be stored in buffer.
+ @param info The readerInfo passed to TXRegexScanStream.
+ @result The number of characters stored in buffer. Return 0 at the end of the stream and -1 for an error.
+ */
+typedef CFIndex (*TXRegexStreamReadCallBack)(UniChar *buffer, CFIndex capacity, void *info);
+
+/*!
+ @typedef TXRegexStreamMatchCallBack
+ @abstract A callback to receive a match found by TXRegexScanStream.
+ @param regexp The TXRegularExpression object searching the stream.
+ @param ranges Ranges of the matched text and the captured groups in the stream. An unmatched group is {kCFNotFound, 0}.
+ @param count The number of elements of ranges. This is the number of capturing groups + 1.
+ @param info The callbackInfo passed to TXRegexScanStream.
+ @result Return false to stop the scanning.
+ */
+typedef Boolean (*TXRegexStreamMatchCallBack)(TXRegexRef regexp, const CFRange *ranges, CFIndex count, void *info);
+
+/*!
+ @function TXRegexScanStream
+ @abstract Find all matches in a stream without holding the whole stream in memory.
+ @discussion The stream is searched through a sliding window of windowSize characters, so the memory usage does not depend on the length of the stream. A match must be shorter than a half of the window. Look-behind assertions can see only kTXRegexStreamContextLength characters before the search position. The target string of regexp is released.
+ @param regexp A TXRegularExpression object.
+ @param reader A callback to read the stream.
+ @param readerInfo A pointer passed to reader.
+ @param windowSize The number of characters of the window. Pass 0 to use kTXRegexStreamDefaultWindowSize.
+ @param callback A callback called for each match. The ranges are offsets from the beginning of the stream in UTF-16 characters.
+ @param callbackInfo A pointer passed to callback.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors. U_FILE_ACCESS_ERROR is returned when reader failed.
+ @result The number of matches passed to callback.
+ */
+CFIndex TXRegexScanStream(TXRegexRef regexp, TXRegexStreamReadCallBack reader, void *readerInfo, CFIndex windowSize,
+						  TXRegexStreamMatchCallBack callback, void *callbackInfo, UErrorCode *status);
+
+/*!
+ @function TXRegexScanFileDescriptor
+ @abstract Find all matches in UTF-8 text read from a file descriptor.
+ @discussion Same as TXRegexScanStream except the stream is read from fd and decoded from UTF-8. Malformed bytes are replaced with U+FFFD. The file descriptor is not closed.
+ @param regexp A TXRegularExpression object.
+ @param fd A file descriptor to read.
+ @param windowSize The number of characters of the window. Pass 0 to use kTXRegexStreamDefaultWindowSize.
+ @param callback A callback called for each match. The ranges are offsets in UTF-16 characters from the beginning of the decoded text.
+ @param callbackInfo A pointer passed to callback.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of matches passed to callback.
+ */
+CFIndex TXRegexScanFileDescriptor(TXRegexRef regexp, int fd, CFIndex windowSize,
+								  TXRegexStreamMatchCallBack callback, void *callbackInfo, UErrorCode *status);
+
+#pragma mark pattern sets
+/*!
+ @typedef TXRegexSetRef
+ @abstract A reference to a set of regular expressions which are matched with a string at once.
+ @discussion A literal which every match of a pattern must contain is extracted from each pattern. The literals of all patterns are searched in one pass with an Aho-Corasick automaton, and only the patterns whose literal is found, or which have no such literal, are run by ICU. A TXRegexSetRef must not be used by multiple threads at the same time.
+ */
+typedef CFDataRef TXRegexSetRef;
+
+/*!
+ @function TXRegexSetCreate
+ @abstract Create a set of regular expressions.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param patterns An array of strings of regular expressions.
+ @param options options of regular expression applied to all patterns.
+ @param parse_error A pointer to UParseError to receive information about errors occurred during parsing.
+ @param errorIndex A pointer to CFIndex to receive the index of the pattern which could not be compiled. Pass NULL if not required.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to a set of regular expressions. NULL is returned when failed.
+ */
+TXRegexSetRef TXRegexSetCreate(CFAllocatorRef allocator, CFArrayRef patterns, uint32_t options,
+							   UParseError *parse_error, CFIndex *errorIndex, UErrorCode *status);
+
+/*!
+ @function TXRegexSetGetCount
+ @abstract Obtain the number of patterns in a set.
+ */
+CFIndex TXRegexSetGetCount(TXRegexSetRef set);
+
+/*!
+ @function TXRegexSetMatchString
+ @abstract Find which patterns of a set match with a string.
+ @discussion When a search fails, the failed pattern and the patterns after it are reported as unmatched, and the result counts only the patterns matched before the failure.
+ @param set A set of regular expressions.
+ @param text A string to process.
+ @param matched An array of Boolean with TXRegexSetGetCount(set) elements to receive whether each pattern matched.
+ @param ranges An array of CFRange with TXRegexSetGetCount(set) elements to receive the range of the first match of each pattern. {kCFNotFound, 0} is stored for an unmatched pattern. Pass NULL if not required.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of matched patterns.
+ */
+CFIndex TXRegexSetMatchString(TXRegexSetRef set, CFStringRef text, Boolean *matched, CFRange *ranges, UErrorCode *status);
+
+#pragma mark replacement
+typedef struct TXRegexOutput *TXRegexOutputRef;
+
+/*!
+ @typedef TXRegexReplacementCallBack
+ @abstract A function called with each match to append its replacement.
+ @discussion The text before the match is already appended to output. Offsets of ranges are indexes of characters. The callback must not change the target of regexp.
+ @param regexp A reference to TXRegularExpression object.
+ @param characters UTF-16 characters of the target string.
+ @param ranges Ranges of captured groups. The location is kCFNotFound for a group which did not participate in the match.
+ @param count The number of ranges.
+ @param output An output buffer to append the replacement with TXRegexOutputAppendCharacters or TXRegexOutputAppendString.
+ @param info A pointer passed to CFStringCreateByReplacingMatchesWithCallback.
+ @result Return false to leave the rest of the target unchanged.
+ */
+typedef Boolean (*TXRegexReplacementCallBack)(TXRegexRef regexp, const UniChar *characters, const CFRange *ranges,
+											   CFIndex count, TXRegexOutputRef output, void *info);
+
+/*!
+ @function TXRegexOutputAppendCharacters
+ @abstract Append characters to the output of a replacement.
+ @param output An output buffer passed to TXRegexReplacementCallBack.
+ @param characters UTF-16 characters to append.
+ @param length The number of characters.
+ @result false when failed to allocate memory.
+ */
+Boolean TXRegexOutputAppendCharacters(TXRegexOutputRef output, const UniChar *characters, CFIndex length);
+
+/*!
+ @function TXRegexOutputAppendString
+ @abstract Append a string to the output of a replacement.
+ @param output An output buffer passed to TXRegexReplacementCallBack.
+ @param string A string to append.
+ @result false when failed to allocate memory.
+ */
+Boolean TXRegexOutputAppendString(TXRegexOutputRef output, CFStringRef string);
+
+#pragma mark split fields
+/*!
+ @typedef TXRegexSplitRef
+ @abstract A reference to fields of a string separated by matches of a regular expression.
+ @discussion Only ranges of fields are obtained when created. A field is made into a string at the first access.
+ */
+typedef CFDataRef TXRegexSplitRef;
+
+/*!
+ @function TXRegexSplitCreate
+ @abstract Split a string with a regular expression.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param text A string to process.
+ @param regexp A reference to TXRegularExpression object.
+ @param maxSplit The maximum number of matches to split at. The rest of the text after the last split is the last field. Pass 0 for no limit.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to fields. NULL is returned when failed.
+ */
+TXRegexSplitRef TXRegexSplitCreate(CFAllocatorRef allocator, CFStringRef text, TXRegexRef regexp,
+								   CFIndex maxSplit, UErrorCode *status);
+
+/*!
+ @function TXRegexSplitGetCount
+ @abstract Obtain the number of fields.
+ @param split A reference to fields.
+ @result The number of fields.
+ */
+CFIndex TXRegexSplitGetCount(TXRegexSplitRef split);
+
+/*!
+ @function TXRegexSplitGetRangeAtIndex
+ @abstract Obtain the range of a field without making a string.
+ @param split A reference to fields.
+ @param index The index of the field.
+ @result The range of the field in the string.
+ */
+CFRange TXRegexSplitGetRangeAtIndex(TXRegexSplitRef split, CFIndex index);
+
+/*!
+ @function TXRegexSplitGetFieldAtIndex
+ @abstract Obtain a field as a string.
+ @discussion The string is made at the first access and kept by split. Ownership follows the Get Rule. Fields can be obtained by multiple threads at the same time.
+ @param split A reference to fields.
+ @param index The index of the field.
+ @result A string of the field.
+ */
+CFStringRef TXRegexSplitGetFieldAtIndex(TXRegexSplitRef split, CFIndex index);
+
+#pragma mark incremental matching
+/*!
+ @typedef TXRegexMatchIndexRef
+ @abstract A reference to all matches of a regular expression in a mutable string, which are kept up to date with edits of the string.
+ @discussion After the string is edited, TXRegexMatchIndexUpdate searches again only from the last match unaffected by the edit until the search reaches a position where the previous matches continue, and the offsets of the following matches are shifted. A TXRegexMatchIndexRef must not be used by multiple threads at the same time.
+ */
+typedef CFDataRef TXRegexMatchIndexRef;
+
+/*!
+ @function TXRegexMatchIndexCreate
+ @abstract Find all matches in a string and keep them to be updated incrementally.
+ @discussion The matches are the same as TXRegexAllMatchesInString as long as no match attempt looks at more than maxMatchLength characters from the position it starts at, including look-ahead and look-behind assertions. The region of regexp is ignored. Patterns using \G are not supported.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param regexp A TXRegularExpression object. The time limit, the stack limit and the match callback of regexp are used.
+ @param text A string to process, which is retained by the new object. The characters are copied, and only the edited characters are read again by TXRegexMatchIndexUpdate.
+ @param maxMatchLength The maximum number of characters a match attempt looks at.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to the matches. NULL is returned when failed.
+ */
+TXRegexMatchIndexRef TXRegexMatchIndexCreate(CFAllocatorRef allocator, TXRegexRef regexp, CFStringRef text,
+											 CFIndex maxMatchLength, UErrorCode *status);
+
+/*!
+ @function TXRegexMatchIndexUpdate
+ @abstract Update the matches after the string was edited.
+ @discussion Call this after each edit of the string, with the range replaced in the string before the edit. When the length of the string does not agree with the edit, U_ILLEGAL_ARGUMENT_ERROR is returned and the matches are not changed.
+ @param index A reference to the matches.
+ @param range The range of the replaced characters in the string before the edit. An insertion is an empty range.
+ @param replacementLength The number of characters which replaced range.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors. The matches are cleared on an error of ICU.
+ @result The range of indexes of the matches which were searched again. The matches before it are unchanged, and the matches after it are the previous matches shifted by the change of the length.
+ */
+CFRange TXRegexMatchIndexUpdate(TXRegexMatchIndexRef index, CFRange range, CFIndex replacementLength, UErrorCode *status);
+CFIndex TXRegexMatchIndexGetCount(TXRegexMatchIndexRef index);
+CFIndex TXRegexMatchIndexGetGroupCount(TXRegexMatchIndexRef index);
+
+/*!
+ @function TXRegexMatchIndexGetRangeAtIndex
+ @abstract Obtain the range of a captured group of a match.
+ @param index A reference to the matches.
+ @param matchIndex The index of the match.
+ @param group The number of the group. 0 for the whole match.
+ @result The range in the string. {kCFNotFound, 0} for a group which did not participate in the match.
+ */
+CFRange TXRegexMatchIndexGetRangeAtIndex(TXRegexMatchIndexRef index, CFIndex matchIndex, CFIndex group);
+
+/*!
+ @function TXRegexMatchIndexGetMatchesInRange
+ @abstract Obtain the indexes of the matches which start in a range of the string, e.g. the visible part of an editor.
+ @result The range of the indexes of the matches.
+ */
+CFRange TXRegexMatchIndexGetMatchesInRange(TXRegexMatchIndexRef index, CFRange range);
+
+#pragma mark pattern archives
+/*!
+ @typedef TXRegexArchiveRef
+ @abstract A reference to regular expressions loaded from an archive.
+ @discussion An archive holds the pattern text, the options and the required literal of each regular expression. Loading an archive only checks its table. A pattern is compiled at the first access, and a syntax error is reported then.
+ */
+typedef CFDataRef TXRegexArchiveRef;
+
+/*!
+ @function TXRegexArchiveCreateData
+ @abstract Serialize regular expressions into an archive.
+ @discussion The archive is in the byte order of the running machine. It does not depend on the version of ICU.
+ @param allocator The allocator to use to allocate memory for the new object. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param regexps An array of TXRegularExpression objects.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A data of the archive. NULL is returned when failed.
+ */
+CFDataRef TXRegexArchiveCreateData(CFAllocatorRef allocator, CFArrayRef regexps, UErrorCode *status);
+
+/*!
+ @function TXRegexArchiveWriteFile
+ @abstract Write an archive of regular expressions to a file.
+ @param regexps An array of TXRegularExpression objects.
+ @param path A path of the file to write.
+ @param status A pointer to UErrorCode to recive any errors. U_FILE_ACCESS_ERROR will be returned when the file can not be written.
+ @result true when succeeded.
+ */
+Boolean TXRegexArchiveWriteFile(CFArrayRef regexps, const char *path, UErrorCode *status);
+
+/*!
+ @function TXRegexArchiveCreate
+ @abstract Load regular expressions from an archive made by TXRegexArchiveCreateData.
+ @discussion data is retained and the patterns are read from it without copying.
+ @param allocator The allocator to use to allocate memory for the new object and the regular expressions. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param data A data of an archive.
+ @param status A pointer to UErrorCode to recive any errors. U_INVALID_FORMAT_ERROR will be returned when data is not a valid archive.
+ @result A reference to the archive. NULL is returned when failed.
+ */
+TXRegexArchiveRef TXRegexArchiveCreate(CFAllocatorRef allocator, CFDataRef data, UErrorCode *status);
+
+/*!
+ @function TXRegexArchiveCreateWithFile
+ @abstract Load regular expressions from an archive file with mmap.
+ @param allocator The allocator to use to allocate memory for the new object and the regular expressions. Pass NULL or kCFAllocatorDefault to use the current default allocator.
+ @param path A path of the archive file.
+ @param status A pointer to UErrorCode to recive any errors. U_FILE_ACCESS_ERROR will be returned when the file can not be mapped.
+ @result A reference to the archive. NULL is returned when failed.
+ */
+TXRegexArchiveRef TXRegexArchiveCreateWithFile(CFAllocatorRef allocator, const char *path, UErrorCode *status);
+CFIndex TXRegexArchiveGetCount(TXRegexArchiveRef archive);
+
+/*!
+ @function TXRegexArchiveGetRegexAtIndex
+ @abstract Obtain a regular expression of an archive.
+ @discussion The pattern is compiled at the first access and the regular expression is kept by archive. Ownership follows the Get Rule. Use TXRegexCreateCopy to match in several threads.
+ @param archive A reference to the archive.
+ @param index The index of the regular expression.
+ @param parse_error A pointer to UParseError to receive information about errors occurred during parsing. Pass NULL if not required.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A reference to TXRegularExpression object. NULL is returned when the pattern can not be compiled.
+ */
+TXRegexRef TXRegexArchiveGetRegexAtIndex(TXRegexArchiveRef archive, CFIndex index,
+										 UParseError *parse_error, UErrorCode *status);
+
+#pragma mark arena allocator
+/*!
+ @function TXRegexArenaCreate
+ @abstract Create an allocator which allocates from large blocks by bumping a pointer.
+ @discussion Pass the arena to TXRegexSetResultAllocator, or to TXRegexCreate, TXRegexCreateCopy or TXRegexCreateWithCache, and the arrays, dictionaries, numbers and strings of the matches are allocated from it. A TXRegularExpression object itself is never allocated from an arena. Releasing an object from the arena costs nothing, and the memory is reclaimed at once by TXRegexArenaReset or when the arena is deallocated. The arena can be used by several threads.
+ @param blockSize The size of the blocks in bytes. Pass 0 to use kTXRegexArenaDefaultBlockSize.
+ @result An allocator. NULL is returned when failed.
+ */
+#define kTXRegexArenaDefaultBlockSize 65536
+CFAllocatorRef TXRegexArenaCreate(CFIndex blockSize);
+
+/*!
+ @function TXRegexArenaReset
+ @abstract Reclaim all memory allocated from an arena, keeping the first block for reuse.
+ @discussion Objects allocated from arena before the reset must not be used or released after the reset. A TXRegularExpression object using the arena for its results stays valid and allocates new results from the arena. Objects of CoreFoundation retain their allocator, so an arena whose objects are dropped without release is never deallocated. Such an arena should be kept and reset for each batch of work.
+ @param arena An allocator made by TXRegexArenaCreate.
+ */
+void TXRegexArenaReset(CFAllocatorRef arena);
+
+/*!
+ @function TXRegexArenaGetAllocatedSize
+ @abstract Obtain the number of bytes of the blocks of an arena.
+ */
+CFIndex TXRegexArenaGetAllocatedSize(CFAllocatorRef arena);
+
 #pragma mark additions to CFString
 /*!
  @function CFStringCreateWithFormattingParseError
@@ -186,6 +1045,20 @@ CFArrayRef CFStringCreateArrayWithFirstMatch(CFStringRef text, TXRegexRef regexp
 CFArrayRef CFStringCreateArrayWithAllMatches(CFStringRef text, TXRegexRef regexp, UErrorCode *status);
 
 CFArrayRef CFStringCreateArrayByRegexSplitting(CFStringRef text, TXRegexRef regexp, UErrorCode *status);
+
+/*!
+ @function CFStringGetRangesByRegexSplitting
+ @abstract Obtain ranges of fields of a string separated by matches of a regular expression without making substrings.
+ @param text A string to process.
+ @param regexp A reference to TXRegularExpression object.
+ @param ranges An array of CFRange to receive ranges of fields.
+ @param capacity The number of elements of ranges.
+ @param maxSplit The maximum number of matches to split at. The rest of the text after the last split is the last field. Pass 0 for no limit.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of fields. It can be larger than capacity, then only capacity ranges are stored.
+ */
+CFIndex CFStringGetRangesByRegexSplitting(CFStringRef text, TXRegexRef regexp, CFRange *ranges, CFIndex capacity,
+										  CFIndex maxSplit, UErrorCode *status);
 CFStringRef CFStringCreateByReplacingFirstMatch(CFStringRef text, TXRegexRef regexp, CFStringRef replacement, UErrorCode *status);
 
 /*!
@@ -198,3 +1071,32 @@ CFStringRef CFStringCreateByReplacingFirstMatch(CFStringRef text, TXRegexRef reg
  @result A formatted error message.
  */
 CFStringRef CFStringCreateByReplacingAllMatches(CFStringRef text, TXRegexRef regexp, CFStringRef replacement, UErrorCode *status);
+
+/*!
+ @function CFStringAppendByReplacingMatches
+ @abstract Append a string with replacing matched strings with a replacement to a mutable string.
+ @discussion The result is written to string in chunks while matching, without making the whole result at once. When an error occurs, a part of the result may have been appended.
+ @param string A mutable string to recive the result.
+ @param text A string to process.
+ @param regexp A reference to TXRegularExpression object.
+ @param replacement A replacement string for matched strings with regexp. $n and ${name} refer captured groups.
+ @param replaceAll Pass true to replace all matches, false to replace only the first match.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result The number of replaced matches.
+ */
+CFIndex CFStringAppendByReplacingMatches(CFMutableStringRef string, CFStringRef text, TXRegexRef regexp,
+										 CFStringRef replacement, Boolean replaceAll, UErrorCode *status);
+
+/*!
+ @function CFStringCreateByReplacingMatchesWithCallback
+ @abstract Create a new string by replacing matched strings with strings made by a callback.
+ @discussion Matches are passed to callback as ranges into the UTF-16 characters of text, and the callback appends its replacement to a shared output buffer. No objects are created for each match.
+ @param text A string to process.
+ @param regexp A reference to TXRegularExpression object.
+ @param callback A function called with each match.
+ @param info A pointer passed to callback.
+ @param status A pointer to UErrorCode to recive any errors. U_ZERO_ERROR will be returned when no errors.
+ @result A new string.
+ */
+CFStringRef CFStringCreateByReplacingMatchesWithCallback(CFStringRef text, TXRegexRef regexp,
+														 TXRegexReplacementCallBack callback, void *info, UErrorCode *status);
@@ -161,6 +161,14 @@ typedef enum UErrorCode {
 	U_REGEX_INVALID_FLAG,                 /**< Invalid value for match mode flags.                */
 	U_REGEX_LOOK_BEHIND_LIMIT,            /**< Look-Behind pattern matches must have a bounded maximum length.    */
 	U_REGEX_SET_CONTAINS_STRING,          /**< Regexps cannot have UnicodeSets containing strings.*/
+	U_REGEX_OCTAL_TOO_BIG,                /**< Octal character constants must be <= 0377.         */
+	U_REGEX_MISSING_CLOSE_BRACKET,        /**< Missing closing bracket on a bracket expression.   */
+	U_REGEX_INVALID_RANGE,                /**< In a character range [x-y], x is greater than y.   */
+	U_REGEX_STACK_OVERFLOW,               /**< Regular expression backtrack stack overflow.       */
+	U_REGEX_TIME_OUT,                     /**< Maximum allowed match time exceeded                */
+	U_REGEX_STOPPED_BY_CALLER,            /**< Matching operation aborted by user callback fn.    */
+	U_REGEX_PATTERN_TOO_BIG,              /**< Pattern exceeds limits on size or complexity.      */
+	U_REGEX_INVALID_CAPTURE_GROUP_NAME,   /**< Invalid capture group name.                        */
 	U_REGEX_ERROR_LIMIT,                  /**< This must always be the last value to indicate the limit for regexp errors */
 	
 	/*
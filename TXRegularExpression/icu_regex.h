@@ -1,3 +1,54 @@
+/*
+ ICU libraries other than libicucore of Mac OS X export functions with the version suffix,
+ e.g. uregex_open_72. Define TX_ICU_VERSION_SUFFIX as the suffix to link with such libraries.
+ */
+#ifdef TX_ICU_VERSION_SUFFIX
+#define TX_ICU_CONCAT_(name, suffix) name##suffix
+#define TX_ICU_CONCAT(name, suffix) TX_ICU_CONCAT_(name, suffix)
+#define TX_ICU_RENAME(name) TX_ICU_CONCAT(name, TX_ICU_VERSION_SUFFIX)
+#define u_austrcpy TX_ICU_RENAME(u_austrcpy)
+#define u_charDigitValue TX_ICU_RENAME(u_charDigitValue)
+#define u_isdigit TX_ICU_RENAME(u_isdigit)
+#define u_strFromUTF8WithSub TX_ICU_RENAME(u_strFromUTF8WithSub)
+#define u_strlen TX_ICU_RENAME(u_strlen)
+#define uregex_clone TX_ICU_RENAME(uregex_clone)
+#define uregex_close TX_ICU_RENAME(uregex_close)
+#define uregex_end TX_ICU_RENAME(uregex_end)
+#define uregex_end64 TX_ICU_RENAME(uregex_end64)
+#define uregex_find TX_ICU_RENAME(uregex_find)
+#define uregex_find64 TX_ICU_RENAME(uregex_find64)
+#define uregex_findNext TX_ICU_RENAME(uregex_findNext)
+#define uregex_flags TX_ICU_RENAME(uregex_flags)
+#define uregex_getText TX_ICU_RENAME(uregex_getText)
+#define uregex_group TX_ICU_RENAME(uregex_group)
+#define uregex_groupCount TX_ICU_RENAME(uregex_groupCount)
+#define uregex_groupNumberFromName TX_ICU_RENAME(uregex_groupNumberFromName)
+#define uregex_hitEnd TX_ICU_RENAME(uregex_hitEnd)
+#define uregex_matches TX_ICU_RENAME(uregex_matches)
+#define uregex_open TX_ICU_RENAME(uregex_open)
+#define uregex_pattern TX_ICU_RENAME(uregex_pattern)
+#define uregex_replaceAll TX_ICU_RENAME(uregex_replaceAll)
+#define uregex_replaceFirst TX_ICU_RENAME(uregex_replaceFirst)
+#define uregex_requireEnd TX_ICU_RENAME(uregex_requireEnd)
+#define uregex_reset TX_ICU_RENAME(uregex_reset)
+#define uregex_setRegion TX_ICU_RENAME(uregex_setRegion)
+#define uregex_setMatchCallback TX_ICU_RENAME(uregex_setMatchCallback)
+#define uregex_setRegionAndStart TX_ICU_RENAME(uregex_setRegionAndStart)
+#define uregex_setStackLimit TX_ICU_RENAME(uregex_setStackLimit)
+#define uregex_setText TX_ICU_RENAME(uregex_setText)
+#define uregex_setTimeLimit TX_ICU_RENAME(uregex_setTimeLimit)
+#define uregex_setUText TX_ICU_RENAME(uregex_setUText)
+#define uregex_start TX_ICU_RENAME(uregex_start)
+#define uregex_start64 TX_ICU_RENAME(uregex_start64)
+#define uregex_useAnchoringBounds TX_ICU_RENAME(uregex_useAnchoringBounds)
+#define uregex_useTransparentBounds TX_ICU_RENAME(uregex_useTransparentBounds)
+#define utext_close TX_ICU_RENAME(utext_close)
+#define utext_openUTF8 TX_ICU_RENAME(utext_openUTF8)
+#endif
+
+struct UText;
+typedef struct UText UText;
+
 URegularExpression *uregex_open(const  UChar   *pattern,
 								int32_t         patternLength,
 								uint32_t        flags,
@@ -13,11 +64,18 @@ const UChar *uregex_pattern(const  URegularExpression   *regexp,
 							int32_t           *patLength,
 							UErrorCode        *status);
 
+int32_t uregex_flags(const URegularExpression *regexp,
+					 UErrorCode *status);
+
 void uregex_setText(URegularExpression *regexp,
 					const UChar        *text,
 					int32_t             textLength,
 					UErrorCode         *status);
 
+void uregex_setUText(URegularExpression *regexp,
+					 UText              *text,
+					 UErrorCode         *status);
+
 const UChar *uregex_getText(URegularExpression *regexp,
 							int32_t            *textLength,
 							UErrorCode         *status);
@@ -30,6 +88,10 @@ UBool uregex_find(URegularExpression *regexp,
 				  int32_t             startIndex, 
 				  UErrorCode         *status);
 
+UBool uregex_find64(URegularExpression *regexp,
+					int64_t             startIndex,
+					UErrorCode         *status);
+
 int32_t uregex_groupCount(URegularExpression *regexp,
 						  UErrorCode         *status);
 
@@ -53,11 +115,60 @@ int32_t uregex_end(URegularExpression   *regexp,
 				   int32_t               groupNum,
 				   UErrorCode           *status);
 
+int64_t uregex_start64(URegularExpression *regexp,
+					   int32_t             groupNum,
+					   UErrorCode          *status);
+
+int64_t uregex_end64(URegularExpression   *regexp,
+					 int32_t               groupNum,
+					 UErrorCode           *status);
+
 void uregex_reset(URegularExpression    *regexp,
 				  int32_t               index,
 				  UErrorCode            *status);
 
 
+void uregex_setRegion(URegularExpression   *regexp,
+					  int32_t               regionStart,
+					  int32_t               limit,
+					  UErrorCode           *status);
+
+void uregex_setRegionAndStart(URegularExpression *regexp,
+							  int64_t               regionStart,
+							  int64_t               regionLimit,
+							  int64_t               startIndex,
+							  UErrorCode           *status);
+
+void uregex_useTransparentBounds(URegularExpression  *regexp,
+								 UBool                b,
+								 UErrorCode          *status);
+
+void uregex_useAnchoringBounds(URegularExpression  *regexp,
+							   UBool                b,
+							   UErrorCode          *status);
+
+UBool uregex_hitEnd(const  URegularExpression   *regexp,
+					UErrorCode          *status);
+
+UBool uregex_requireEnd(const  URegularExpression   *regexp,
+						UErrorCode          *status);
+
+void uregex_setTimeLimit(URegularExpression *regexp,
+						 int32_t             limit,
+						 UErrorCode         *status);
+
+void uregex_setStackLimit(URegularExpression *regexp,
+						  int32_t             limit,
+						  UErrorCode         *status);
+
+typedef UBool URegexMatchCallback(const void *context,
+								  int32_t     steps);
+
+void uregex_setMatchCallback(URegularExpression  *regexp,
+							 URegexMatchCallback *callback,
+							 const void          *context,
+							 UErrorCode          *status);
+
 int32_t uregex_replaceAll(URegularExpression    *regexp,
 						  const UChar           *replacementText,
 						  int32_t                replacementLength,
@@ -65,6 +176,11 @@ int32_t uregex_replaceAll(URegularExpression    *regexp,
 						  int32_t                destCapacity,
 						  UErrorCode            *status);
 
+int32_t uregex_groupNumberFromName(URegularExpression *regexp,
+								   const UChar        *groupName,
+								   int32_t             nameLength,
+								   UErrorCode          *status);
+
 int32_t uregex_replaceFirst(URegularExpression  *regexp,
 							const UChar         *replacementText,
 							int32_t              replacementLength,
@@ -75,4 +191,24 @@ int32_t uregex_replaceFirst(URegularExpression  *regexp,
 char* u_austrcpy(char *dst,
 				 const UChar *src );
 
-int32_t u_strlen(const UChar *s);
\ No newline at end of file
+int32_t u_strlen(const UChar *s);
+
+UBool u_isdigit(UChar32 c);
+
+int32_t u_charDigitValue(UChar32 c);
+
+UChar *u_strFromUTF8WithSub(UChar *dest,
+							int32_t destCapacity,
+							int32_t *pDestLength,
+							const char *src,
+							int32_t srcLength,
+							int32_t subchar,
+							int32_t *pNumSubstitutions,
+							UErrorCode *pErrorCode);
+
+UText *utext_openUTF8(UText *ut,
+					  const char *s,
+					  int64_t length,
+					  UErrorCode *status);
+
+UText *utext_close(UText *ut);
@@ -0,0 +1,537 @@
+#include <CoreFoundation/CoreFoundation.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "TXRegularExpression.h"
+
+/*
+ Microbenchmarks of TXRegularExpression. Each benchmark is repeated until it runs for
+ kBenchmarkMinSeconds, and reports nanoseconds, allocations through the default CFAllocator and
+ megabytes of UTF-16 target text per operation.
+
+ usage : regex-benchmark [name]
+ Only benchmarks whose name contains the argument are run.
+ */
+
+#define kBenchmarkMinSeconds 0.5
+#define kCorpusLength (1 << 20)
+
+#pragma mark counting allocator
+
+static long AllocationCount = 0;
+
+static void *CountingAllocate(CFIndex size, CFOptionFlags hint, void *info)
+{
+	__atomic_add_fetch(&AllocationCount, 1, __ATOMIC_RELAXED);
+	return malloc(size);
+}
+
+static void *CountingReallocate(void *ptr, CFIndex newsize, CFOptionFlags hint, void *info)
+{
+	__atomic_add_fetch(&AllocationCount, 1, __ATOMIC_RELAXED);
+	return realloc(ptr, newsize);
+}
+
+static void CountingDeallocate(void *ptr, void *info)
+{
+	free(ptr);
+}
+
+static CFAllocatorRef CreateCountingAllocator(void)
+{
+	CFAllocatorContext context =
+	{0, // version
+		NULL, //info
+		NULL, // retain callback
+		NULL,  //  CFAllocatorReleaseCallBack
+		NULL, // CFAllocatorCopyDescriptionCallBack
+		CountingAllocate, //CFAllocatorAllocateCallBack
+		CountingReallocate, // CFAllocatorReallocateCallBack
+		CountingDeallocate, //CFAllocatorDeallocateCallBack
+		NULL //CFAllocatorPreferredSizeCallBack
+	};
+	return CFAllocatorCreate(kCFAllocatorSystemDefault, &context);
+}
+
+#pragma mark corpora
+
+// a linear congruential generator, so that corpora are identical on every run.
+static uint32_t RandomState = 12345;
+
+static uint32_t NextRandom(void)
+{
+	RandomState = RandomState * 1103515245 + 12345;
+	return (RandomState >> 16) & 0x7fff;
+}
+
+static const char *Words[] = {"regular", "expression", "pattern", "match", "string", "buffer",
+	"capture", "group", "replace", "split", "unicode", "character", "the", "of", "and", "a",
+	"\xE6\xAD\xA3\xE8\xA6\x8F\xE8\xA1\xA8\xE7\x8F\xBE", "\xE6\x96\x87\xE5\xAD\x97\xE5\x88\x97"};
+
+static CFStringRef CreateCorpus(const char *name)
+{
+	char *buffer = malloc(kCorpusLength + 256);
+	size_t length = 0;
+	RandomState = 12345;
+	while (length < kCorpusLength) {
+		char *line = buffer + length;
+		if (0 == strcmp(name, "log")) {
+			length += sprintf(line, "192.168.%u.%u - - [17/Oct/2026:%02u:%02u:%02u] \"%s /%s/%s-%u.html HTTP/1.1\" %u %u\n",
+							  NextRandom() % 256, NextRandom() % 256,
+							  NextRandom() % 24, NextRandom() % 60, NextRandom() % 60,
+							  (NextRandom() % 4) ? "GET" : "POST",
+							  Words[NextRandom() % 12], Words[NextRandom() % 12], NextRandom() % 1000,
+							  (NextRandom() % 10) ? 200 : 404, NextRandom());
+		} else if (0 == strcmp(name, "csv")) {
+			length += sprintf(line, "%u,%s,%u.%02u,\"%s %s\",2026-%02u-%02u\n",
+							  NextRandom(), Words[NextRandom() % 18], NextRandom() % 1000, NextRandom() % 100,
+							  Words[NextRandom() % 18], Words[NextRandom() % 18],
+							  NextRandom() % 12 + 1, NextRandom() % 28 + 1);
+		} else {
+			for (int n = 0; n < 12; n++) {
+				length += sprintf(buffer + length, "%s ", Words[NextRandom() % 18]);
+			}
+			length += sprintf(buffer + length, "%u.\n", NextRandom());
+		}
+	}
+	// a match only at the end, for searches which scan the whole corpus.
+	length += sprintf(buffer + length, "ERROR 500 at the end\n");
+	CFStringRef corpus = CFStringCreateWithBytes(kCFAllocatorDefault, (const UInt8 *)buffer, length,
+												 kCFStringEncodingUTF8, false);
+	free(buffer);
+	return corpus;
+}
+
+#pragma mark benchmarks
+
+typedef struct {
+	CFStringRef corpus;
+	CFStringRef pattern;
+	CFStringRef replacement;
+	TXRegexRef regexp;
+	TXRegexSetRef set;
+	CFDataRef archive; // an archive of regexp
+	CFStringRef *lines; // lines of corpus for per-line benchmarks
+	CFIndex lineCount;
+	CFRange *ranges;
+	CFIndex sink; // results are accumulated, so that operations are not optimized out.
+	UErrorCode status;
+} BenchmarkContext;
+
+typedef struct {
+	const char *name;
+	const char *corpus; // "log", "csv", "text" or NULL for benchmarks without a target.
+	const char *pattern;
+	const char *replacement;
+	void (*run)(BenchmarkContext *context, long iterations);
+	Boolean lines; // the corpus is split into lines before running.
+} Benchmark;
+
+static void ReleaseResult(BenchmarkContext *context, CFTypeRef result)
+{
+	if (result) {
+		context->sink += CFGetRetainCount(result);
+		CFRelease(result);
+	}
+}
+
+static void RunCreate(BenchmarkContext *context, long iterations)
+{
+	UParseError parse_error;
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, TXRegexCreate(kCFAllocatorDefault, context->pattern, 0, &parse_error, &context->status));
+	}
+}
+
+static void RunCreateWithCache(BenchmarkContext *context, long iterations)
+{
+	UParseError parse_error;
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, TXRegexCreateWithCache(kCFAllocatorDefault, context->pattern, 0, &parse_error, &context->status));
+	}
+}
+
+static void RunArchiveGetRegexAtIndex(BenchmarkContext *context, long iterations)
+{
+	UParseError parse_error;
+	for (long n = 0; n < iterations; n++) {
+		TXRegexArchiveRef archive = TXRegexArchiveCreate(kCFAllocatorDefault, context->archive, &context->status);
+		if (!archive) return;
+		context->sink += CFGetRetainCount(TXRegexArchiveGetRegexAtIndex(archive, 0, &parse_error, &context->status));
+		CFRelease(archive);
+	}
+}
+
+static void RunSetString(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		context->sink += TXRegexSetString(context->regexp, context->corpus, &context->status);
+	}
+}
+
+static void RunFirstMatchInString(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, TXRegexFirstMatchInString(context->regexp, context->corpus, 0, &context->status));
+	}
+}
+
+static void RunAllMatchesInString(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, TXRegexAllMatchesInString(context->regexp, context->corpus, &context->status));
+	}
+}
+
+static void RunAllMatchesWithSubstrings(BenchmarkContext *context, long iterations)
+{
+	TXRegexSetGroupMode(context->regexp, kTXRegexGroupSubstring);
+	RunAllMatchesInString(context, iterations);
+}
+
+static void RunAllMatchesWithArena(BenchmarkContext *context, long iterations)
+{
+	CFAllocatorRef arena = TXRegexArenaCreate(0);
+	TXRegexRef regexp = TXRegexCreateCopy(kCFAllocatorDefault, context->regexp, &context->status);
+	if (regexp) {
+		TXRegexSetResultAllocator(regexp, arena);
+		for (long n = 0; n < iterations; n++) {
+			ReleaseResult(context, TXRegexAllMatchesInString(regexp, context->corpus, &context->status));
+			TXRegexArenaReset(arena);
+		}
+		CFRelease(regexp);
+	}
+	CFRelease(arena);
+}
+
+static void RunMatchIndexUpdate(BenchmarkContext *context, long iterations)
+{
+	// a character is typed and deleted again at scattered positions.
+	CFMutableStringRef text = CFStringCreateMutableCopy(kCFAllocatorDefault, 0, context->corpus);
+	TXRegexMatchIndexRef index = TXRegexMatchIndexCreate(kCFAllocatorDefault, context->regexp, text, 1024, &context->status);
+	CFIndex location = 0;
+	for (long n = 0; index && (n < iterations); n++) {
+		if (n % 2) {
+			CFStringDelete(text, CFRangeMake(location, 1));
+			context->sink += TXRegexMatchIndexUpdate(index, CFRangeMake(location, 1), 0, &context->status).length;
+		} else {
+			location = (CFIndex)(((uint64_t)NextRandom() << 15 | NextRandom()) % CFStringGetLength(text));
+			CFStringReplace(text, CFRangeMake(location, 0), CFSTR("x"));
+			context->sink += TXRegexMatchIndexUpdate(index, CFRangeMake(location, 0), 1, &context->status).length;
+		}
+	}
+	if (index) CFRelease(index);
+	CFRelease(text);
+}
+
+static void RunHasMatch(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		context->sink += TXRegexHasMatch(context->regexp, context->corpus, &context->status);
+	}
+}
+
+static void RunCountMatches(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		context->sink += TXRegexCountMatches(context->regexp, context->corpus, &context->status);
+	}
+}
+
+static void RunAllMatchesInStringParallel(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, TXRegexAllMatchesInStringParallel(context->regexp, context->corpus, 1024, 0,
+																  &context->status));
+	}
+}
+
+static void RunAllMatchesAsync(BenchmarkContext *context, long iterations)
+{
+	// all jobs are queued at once, so the pool runs as many as it has threads.
+	TXRegexJobRef *jobs = malloc(iterations * sizeof(TXRegexJobRef));
+	long submitted = 0;
+	for (; submitted < iterations; submitted++) {
+		jobs[submitted] = TXRegexAllMatchesAsync(kCFAllocatorDefault, context->regexp, context->corpus, NULL, NULL,
+												 &context->status);
+		if (!jobs[submitted]) break;
+	}
+	for (long n = 0; n < submitted; n++) {
+		UErrorCode status = U_ZERO_ERROR;
+		CFArrayRef matches = TXRegexJobGetMatches(jobs[n], &status);
+		if (matches) context->sink += CFArrayGetCount(matches);
+		if ((U_ZERO_ERROR != status) && (U_ZERO_ERROR == context->status)) context->status = status;
+		CFRelease(jobs[n]);
+	}
+	free(jobs);
+}
+
+static void RunNextMatchRanges(BenchmarkContext *context, long iterations)
+{
+	CFRange ranges[8];
+	for (long n = 0; n < iterations; n++) {
+		TXRegexSetString(context->regexp, context->corpus, &context->status);
+		while (TXRegexNextMatchRanges(context->regexp, ranges, 8, &context->status) > 0) {
+			context->sink += ranges[0].length;
+		}
+	}
+}
+
+static void RunIsMatched(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		context->sink += CFStringIsMatchedWithRegex(context->corpus, context->regexp, &context->status);
+	}
+}
+
+static void RunIsMatchedLines(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		for (CFIndex k = 0; k < context->lineCount; k++) {
+			context->sink += CFStringIsMatchedWithRegex(context->lines[k], context->regexp, &context->status);
+		}
+	}
+}
+
+// the same lines come again and again, as in a log of a few distinct messages.
+#define kRepeatedLineCount 256
+
+static void RunIsMatchedRepeatedLines(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		for (CFIndex k = 0; k < context->lineCount; k++) {
+			context->sink += CFStringIsMatchedWithRegex(context->lines[k % kRepeatedLineCount], context->regexp,
+														&context->status);
+		}
+	}
+}
+
+static void RunIsMatchedRepeatedLinesCached(BenchmarkContext *context, long iterations)
+{
+	TXRegexSetResultCacheCapacity(context->regexp, kRepeatedLineCount, &context->status);
+	RunIsMatchedRepeatedLines(context, iterations);
+	TXRegexSetResultCacheCapacity(context->regexp, 0, &context->status);
+}
+
+static void RunMatchBatch(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		TXRegexBatchRef batch = TXRegexMatchBatch(kCFAllocatorDefault, context->regexp, context->lines,
+												  context->lineCount, 0, &context->status);
+		if (!batch) return;
+		context->sink += TXRegexBatchGetResults(batch)->matchCount;
+		CFRelease(batch);
+	}
+}
+
+static void RunSplitting(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, CFStringCreateArrayByRegexSplitting(context->corpus, context->regexp, &context->status));
+	}
+}
+
+static void RunSplittingRanges(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		context->sink += CFStringGetRangesByRegexSplitting(context->corpus, context->regexp, context->ranges,
+														   kCorpusLength, 0, &context->status);
+	}
+}
+
+static void RunReplacingFirstMatch(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, CFStringCreateByReplacingFirstMatch(context->corpus, context->regexp,
+																   context->replacement, &context->status));
+	}
+}
+
+static void RunReplacingAllMatches(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, CFStringCreateByReplacingAllMatches(context->corpus, context->regexp,
+																   context->replacement, &context->status));
+	}
+}
+
+static Boolean SwapGroups(TXRegexRef regexp, const UniChar *characters, const CFRange *ranges,
+						  CFIndex count, TXRegexOutputRef output, void *info)
+{
+	TXRegexOutputAppendCharacters(output, characters + ranges[2].location, ranges[2].length);
+	TXRegexOutputAppendCharacters(output, characters + ranges[1].location, ranges[1].length);
+	return true;
+}
+
+static void RunReplacingWithCallback(BenchmarkContext *context, long iterations)
+{
+	for (long n = 0; n < iterations; n++) {
+		ReleaseResult(context, CFStringCreateByReplacingMatchesWithCallback(context->corpus, context->regexp,
+																			SwapGroups, NULL, &context->status));
+	}
+}
+
+static void RunSetMatchString(BenchmarkContext *context, long iterations)
+{
+	Boolean matched[8];
+	for (long n = 0; n < iterations; n++) {
+		context->sink += TXRegexSetMatchString(context->set, context->corpus, matched, NULL, &context->status);
+	}
+}
+
+static const Benchmark Benchmarks[] = {
+	{"TXRegexCreate", NULL, "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunCreate},
+	{"TXRegexCreateWithCache", NULL, "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunCreateWithCache},
+	{"TXRegexArchiveGetRegexAtIndex", NULL, "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunArchiveGetRegexAtIndex},
+	{"TXRegexSetString", "log", "a", NULL, RunSetString},
+	{"TXRegexFirstMatchInString", "log", "ERROR ([0-9]+)", NULL, RunFirstMatchInString},
+	{"TXRegexFirstMatchInString", "text", "[0-9]+ at the (end)", NULL, RunFirstMatchInString},
+	{"TXRegexAllMatchesInString", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunAllMatchesInString},
+	{"TXRegexAllMatchesInString substrings", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunAllMatchesWithSubstrings},
+	{"TXRegexAllMatchesInString arena", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunAllMatchesWithArena},
+	{"TXRegexMatchIndexUpdate", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunMatchIndexUpdate},
+	{"TXRegexHasMatch", "text", "[0-9]+ at the (end)", NULL, RunHasMatch},
+	{"TXRegexCountMatches", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunCountMatches},
+	{"TXRegexCountMatches literal", "log", "POST", NULL, RunCountMatches},
+	{"TXRegexCountMatches literal with ICU", "log", "(?:POST)", NULL, RunCountMatches},
+	{"TXRegexHasMatch anchored literal", "log", "at the end$", NULL, RunHasMatch},
+	{"TXRegexHasMatch anchored literal with ICU", "log", "(?:at the end$)", NULL, RunHasMatch},
+	{"TXRegexAllMatchesInStringParallel", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunAllMatchesInStringParallel},
+	{"TXRegexAllMatchesAsync", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunAllMatchesAsync},
+	{"TXRegexNextMatchRanges", "log", "\"(GET|POST) /([a-z]+)/([^ \"]+)\" ([0-9]{3})", NULL, RunNextMatchRanges},
+	{"CFStringIsMatchedWithRegex", "text", "(?s).*ERROR [0-9]+.*", NULL, RunIsMatched},
+	{"CFStringIsMatchedWithRegex lines", "log", "\" 404 [0-9]+", NULL, RunIsMatchedLines, true},
+	{"CFStringIsMatchedWithRegex repeats", "log", "\" 404 [0-9]+", NULL, RunIsMatchedRepeatedLines, true},
+	{"CFStringIsMatchedWithRegex repeats cached", "log", "\" 404 [0-9]+", NULL, RunIsMatchedRepeatedLinesCached, true},
+	{"TXRegexMatchBatch lines", "log", "\" 404 [0-9]+", NULL, RunMatchBatch, true},
+	{"CFStringCreateArrayByRegexSplitting", "csv", ",|\\n", NULL, RunSplitting},
+	{"CFStringGetRangesByRegexSplitting", "csv", ",|\\n", NULL, RunSplittingRanges},
+	{"CFStringCreateByReplacingFirstMatch", "log", "ERROR ([0-9]+)", "<$1>", RunReplacingFirstMatch},
+	{"CFStringCreateByReplacingAllMatches", "text", "\\b(\\w)(\\w*)\\b", "$2$1", RunReplacingAllMatches},
+	{"CFStringCreateByReplacingAllMatches", "log", "[0-9]+", "<$0>", RunReplacingAllMatches},
+	{"CFStringCreateByReplacingMatchesWithCallback", "text", "\\b(\\w)(\\w*)\\b", NULL, RunReplacingWithCallback},
+	{"TXRegexSetMatchString", "log", NULL, NULL, RunSetMatchString},
+};
+
+static const char *SetPatterns[] = {"ERROR ([0-9]+)", "\" 404 [0-9]+", "POST /split/", "\\[17/Oct/2026:23:59:[0-9]{2}\\]"};
+
+static double CurrentSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static Boolean SetUpBenchmark(const Benchmark *benchmark, BenchmarkContext *context, CFStringRef *corpora)
+{
+	UParseError parse_error;
+	memset(context, 0, sizeof(BenchmarkContext));
+	if (benchmark->corpus) {
+		if (0 == strcmp(benchmark->corpus, "log")) context->corpus = corpora[0];
+		else if (0 == strcmp(benchmark->corpus, "csv")) context->corpus = corpora[1];
+		else context->corpus = corpora[2];
+	}
+	if (benchmark->pattern) {
+		context->pattern = CFStringCreateWithCString(kCFAllocatorDefault, benchmark->pattern, kCFStringEncodingUTF8);
+		context->regexp = TXRegexCreate(kCFAllocatorDefault, context->pattern, 0, &parse_error, &context->status);
+		if (context->regexp) {
+			CFArrayRef regexps = CFArrayCreate(kCFAllocatorDefault, (const void **)&context->regexp, 1, &kCFTypeArrayCallBacks);
+			context->archive = TXRegexArchiveCreateData(kCFAllocatorDefault, regexps, &context->status);
+			CFRelease(regexps);
+		}
+	} else {
+		CFStringRef patterns[4];
+		for (int n = 0; n < 4; n++) {
+			patterns[n] = CFStringCreateWithCString(kCFAllocatorDefault, SetPatterns[n], kCFStringEncodingUTF8);
+		}
+		CFArrayRef array = CFArrayCreate(kCFAllocatorDefault, (const void **)patterns, 4, &kCFTypeArrayCallBacks);
+		context->set = TXRegexSetCreate(kCFAllocatorDefault, array, 0, &parse_error, NULL, &context->status);
+		CFRelease(array);
+		for (int n = 0; n < 4; n++) CFRelease(patterns[n]);
+	}
+	if (benchmark->replacement) {
+		context->replacement = CFStringCreateWithCString(kCFAllocatorDefault, benchmark->replacement, kCFStringEncodingUTF8);
+	}
+	context->ranges = malloc(kCorpusLength * sizeof(CFRange));
+	if (benchmark->lines) {
+		CFIndex length = CFStringGetLength(context->corpus);
+		context->lines = malloc(length * sizeof(CFStringRef));
+		CFIndex start = 0;
+		for (CFIndex n = 0; n < length; n++) {
+			if ('\n' != CFStringGetCharacterAtIndex(context->corpus, n)) continue;
+			context->lines[context->lineCount++] = CFStringCreateWithSubstring(kCFAllocatorDefault, context->corpus,
+																			   CFRangeMake(start, n - start));
+			start = n + 1;
+		}
+	}
+	if (U_ZERO_ERROR != context->status) {
+		fprintf(stderr, "Error on setting up %s with UErrorCode : %d\n", benchmark->name, context->status);
+		fprintParseError(stderr, &parse_error);
+		return false;
+	}
+	return true;
+}
+
+static void TearDownBenchmark(BenchmarkContext *context)
+{
+	if (context->pattern) CFRelease(context->pattern);
+	if (context->replacement) CFRelease(context->replacement);
+	if (context->regexp) CFRelease(context->regexp);
+	if (context->set) CFRelease(context->set);
+	if (context->archive) CFRelease(context->archive);
+	for (CFIndex n = 0; n < context->lineCount; n++) CFRelease(context->lines[n]);
+	free(context->lines);
+	free(context->ranges);
+}
+
+int main (int argc, const char * argv[]) {
+	const char *filter = (argc > 1) ? argv[1] : NULL;
+	CFAllocatorRef counting_allocator = CreateCountingAllocator();
+	CFAllocatorSetDefault(counting_allocator);
+
+	CFStringRef corpora[3] = {CreateCorpus("log"), CreateCorpus("csv"), CreateCorpus("text")};
+	fprintf(stdout, "%-46s %-6s %14s %12s %10s\n", "benchmark", "corpus", "ns/op", "allocs/op", "MB/s");
+	for (size_t k = 0; k < sizeof(Benchmarks)/sizeof(Benchmark); k++) {
+		const Benchmark *benchmark = &Benchmarks[k];
+		if (filter && !strstr(benchmark->name, filter)) continue;
+		BenchmarkContext context;
+		if (!SetUpBenchmark(benchmark, &context, corpora)) {
+			TearDownBenchmark(&context);
+			return 1;
+		}
+
+		// double the iterations until the benchmark runs long enough.
+		long iterations = 1;
+		double elapsed = 0;
+		long allocations = 0;
+		while (true) {
+			long start_allocations = __atomic_load_n(&AllocationCount, __ATOMIC_RELAXED);
+			double start = CurrentSeconds();
+			benchmark->run(&context, iterations);
+			elapsed = CurrentSeconds() - start;
+			allocations = __atomic_load_n(&AllocationCount, __ATOMIC_RELAXED) - start_allocations;
+			if (U_ZERO_ERROR != context.status) {
+				fprintf(stderr, "Error on %s with UErrorCode : %d\n", benchmark->name, context.status);
+				TearDownBenchmark(&context);
+				return 1;
+			}
+			if (elapsed >= kBenchmarkMinSeconds) break;
+			iterations *= 2;
+		}
+
+		double ns_per_op = elapsed * 1e9 / iterations;
+		fprintf(stdout, "%-46s %-6s %14.0f %12.1f ", benchmark->name,
+				benchmark->corpus ? benchmark->corpus : "-", ns_per_op, (double)allocations / iterations);
+		if (context.corpus) {
+			double megabytes = CFStringGetLength(context.corpus) * sizeof(UniChar) / 1e6;
+			fprintf(stdout, "%10.1f\n", megabytes * iterations / elapsed);
+		} else {
+			fprintf(stdout, "%10s\n", "-");
+		}
+		TearDownBenchmark(&context);
+	}
+
+	for (int n = 0; n < 3; n++) CFRelease(corpora[n]);
+	return 0;
+}
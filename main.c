@@ -1,5 +1,8 @@
 #include <CoreFoundation/CoreFoundation.h>
+#include <unistd.h>
+#include <time.h>
 #include "TXRegularExpression.h"
+#include "icu_regex.h"
 
 void test_CFStringCreateArrayByRegexSplitting()
 {
@@ -20,6 +23,38 @@ void test_CFStringCreateArrayByRegexSplitting()
 	CFShow(array);
 }
 
+void test_TXRegexSplitCreate()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("\\s*,\\s*"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef record = CFSTR("id, name , , price,quantity");
+	CFRange ranges[8];
+	CFIndex count = CFStringGetRangesByRegexSplitting(record, regexp, ranges, 8, 2, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on CFStringGetRangesByRegexSplitting with UErrorCode : %d\n", status);
+		return;
+	}
+	for (CFIndex n = 0; n < count; n++) {
+		fprintf(stderr, "field %ld : {%ld, %ld}\n", n, ranges[n].location, ranges[n].length);
+	}
+	
+	TXRegexSplitRef split = TXRegexSplitCreate(kCFAllocatorDefault, record, regexp, 0, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexSplitCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	fprintf(stderr, "fields : %ld\n", TXRegexSplitGetCount(split));
+	CFShow(TXRegexSplitGetFieldAtIndex(split, 3));
+	CFRelease(split);
+	CFRelease(regexp);
+}
+
 void test_RegexFirstMatchInString()
 {
 	UParseError parse_error;
@@ -60,6 +95,247 @@ void test_TXRegexAllMatchesInString()
 	CFShow(array);	
 }
 
+void test_TXRegexCountMatches()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.scpt"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef text = CFSTR("basename-1a.scpt basenam.scpt basename.scpt");
+	Boolean found = TXRegexHasMatch(regexp, text, &status);
+	CFIndex count = TXRegexCountMatches(regexp, text, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexCountMatches with UErrorCode : %d\n", status);
+	}
+	fprintf(stderr, "has match : %d, matches : %ld\n", found, count);
+	CFRelease(regexp);
+}
+
+void test_TXRegexLiteralPattern()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("\\.scpt$"), UREGEX_CASE_INSENSITIVE, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef text = CFSTR("basename-1a.scpt basename.SCPT\n");
+	Boolean found = TXRegexHasMatch(regexp, text, &status);
+	CFIndex count = TXRegexCountMatches(regexp, text, &status);
+	Boolean matched = CFStringIsMatchedWithRegex(CFSTR(".Scpt"), regexp, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexCountMatches with UErrorCode : %d\n", status);
+	}
+	fprintf(stderr, "has match : %d, matches : %ld, whole match : %d\n", found, count, matched);
+	CFRelease(regexp);
+}
+
+void test_TXRegexSetTimeLimit()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("(a+)+$"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	TXRegexSetTimeLimit(regexp, 10, &status);
+	Boolean found = TXRegexHasMatch(regexp, CFSTR("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"), &status);
+	if (status == U_REGEX_TIME_OUT) {
+		fputs("TXRegexHasMatch timed out\n", stderr);
+	} else {
+		fprintf(stderr, "has match : %d, UErrorCode : %d\n", found, status);
+	}
+	
+	// searches stopped on the worker threads of a batch are counted by regexp.
+	TXRegexSetStatisticsEnabled(true);
+	CFStringRef texts[] = {CFSTR("ab"), CFSTR("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"),
+		CFSTR("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"), CFSTR("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab")};
+	status = U_ZERO_ERROR;
+	TXRegexBatchRef batch = TXRegexMatchBatch(kCFAllocatorDefault, regexp, texts, 4, 4, &status);
+	if (batch) CFRelease(batch);
+	TXRegexStatistics statistics;
+	TXRegexGetStatistics(regexp, &statistics);
+	fprintf(stderr, "batch UErrorCode : %d, limit trips : %ld\n", status, statistics.limitTrips);
+	TXRegexSetStatisticsEnabled(false);
+	CFRelease(regexp);
+}
+
+void test_TXRegexArenaCreate()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	CFAllocatorRef arena = TXRegexArenaCreate(0);
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		CFRelease(arena);
+		return;
+	}
+	TXRegexSetResultAllocator(regexp, arena);
+	// the regular expression is reused after each reset of the arena.
+	for (int n = 0; n < 2; n++) {
+		CFArrayRef array = TXRegexAllMatchesInString(regexp, CFSTR("basename-1a.scpt basename.txt"), &status);
+		if (status != U_ZERO_ERROR) {
+			fprintf(stderr, "Error on TXRegexAllMatchesInString with UErrorCode : %d\n", status);
+		}
+		if (array) {
+			CFShow(array);
+			CFRelease(array);
+		}
+		fprintf(stderr, "arena size : %ld\n", TXRegexArenaGetAllocatedSize(arena));
+		TXRegexArenaReset(arena);
+	}
+	CFRelease(regexp);
+	CFRelease(arena);
+}
+
+void test_TXRegexSetRegion()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	// only the second file name is searched.
+	TXRegexSetRegion(regexp, CFRangeMake(17, 12), false, true, &status);
+	CFArrayRef array = TXRegexAllMatchesInString(regexp, CFSTR("basename-1a.scpt basename.txt basename-2b.scpt"), &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesInString with UErrorCode : %d\n", status);
+	}
+	if (array) {
+		CFShow(array);
+		CFRelease(array);
+	}
+	CFRelease(regexp);
+}
+
+void test_TXRegexMatchIndexCreate()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFMutableStringRef text = CFStringCreateMutableCopy(kCFAllocatorDefault, 0, CFSTR("basename-1a.scpt basename.txt"));
+	TXRegexMatchIndexRef index = TXRegexMatchIndexCreate(kCFAllocatorDefault, regexp, text, 256, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexMatchIndexCreate with UErrorCode : %d\n", status);
+		goto bail;
+	}
+	// edit the first file name.
+	CFStringReplace(text, CFRangeMake(8, 3), CFSTR("-2b3"));
+	CFRange updated = TXRegexMatchIndexUpdate(index, CFRangeMake(8, 3), 4, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexMatchIndexUpdate with UErrorCode : %d\n", status);
+	}
+	fprintf(stderr, "searched again : %ld matches from %ld\n", updated.length, updated.location);
+	for (CFIndex n = 0; n < TXRegexMatchIndexGetCount(index); n++) {
+		CFRange range = TXRegexMatchIndexGetRangeAtIndex(index, n, 0);
+		fprintf(stderr, "match %ld : {%ld, %ld}\n", n, range.location, range.length);
+	}
+	CFRelease(index);
+bail:
+	CFRelease(text);
+	CFRelease(regexp);
+}
+
+void test_TXRegexSetResultCacheCapacity()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	TXRegexSetResultCacheCapacity(regexp, 16, &status);
+	CFStringRef names[] = {CFSTR("basename-1a.scpt"), CFSTR("basename.txt"), CFSTR("basename-1a.scpt")};
+	for (int n = 0; n < 3; n++) {
+		CFArrayRef array = CFStringCreateArrayWithFirstMatch(names[n], regexp, 0, &status);
+		if (status != U_ZERO_ERROR) {
+			fprintf(stderr, "Error on CFStringCreateArrayWithFirstMatch with UErrorCode : %d\n", status);
+			break;
+		}
+		if (array) {
+			CFShow(array);
+			CFRelease(array);
+		}
+	}
+	TXRegexCacheStatistics statistics;
+	TXRegexGetResultCacheStatistics(regexp, &statistics);
+	fprintf(stderr, "hits : %ld, misses : %ld, count : %ld\n", statistics.hits, statistics.misses, statistics.count);
+	CFRelease(regexp);
+}
+
+static void PrintJobMatches(TXRegexJobRef job, CFArrayRef matches, UErrorCode status, void *info)
+{
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesAsync with UErrorCode : %d\n", status);
+		return;
+	}
+	CFShow(matches);
+}
+
+void test_TXRegexAllMatchesAsync()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	TXRegexJobRef job = TXRegexAllMatchesAsync(kCFAllocatorDefault, regexp, CFSTR("basename-1a.scpt basename.txt"),
+											   PrintJobMatches, NULL, &status);
+	CFRelease(regexp); // the job has its own copy.
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesAsync with UErrorCode : %d\n", status);
+		return;
+	}
+	CFArrayRef matches = TXRegexJobGetMatches(job, &status);
+	fprintf(stderr, "finished : %d, matches : %ld\n", TXRegexJobIsFinished(job), matches ? CFArrayGetCount(matches) : 0);
+	CFRelease(job);
+}
+
+void test_TXRegexSetGroupMode()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	TXRegexSetGroupMode(regexp, kTXRegexGroupSubstring);
+	CFArrayRef array = TXRegexAllMatchesInString(regexp, CFSTR("basename-1a.scpt basename.txt"), &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesInString with UErrorCode : %d\n", status);
+	}
+	if (array) {
+		CFShow(array);
+		CFRelease(array);
+	}
+	CFRelease(regexp);
+}
+
 void test_CFStringCreateArrayWithFirstMatch()
 {
 	UParseError parse_error;
@@ -166,6 +442,489 @@ void test_CFStringCreateByReplacingAllMatches()
 	CFShow(string);
 }
 
+// compare CFStringCreateByReplacingAllMatches with uregex_replaceAll of ICU.
+void test_CFStringCreateByReplacingAllMatchesWithICU()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	// 15 groups
+	CFStringRef pattern = CFSTR("(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)(l)(m)(n)(?<last>o)");
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, pattern, 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	UniChar pattern_chars[64];
+	CFIndex pattern_length = CFStringGetLength(pattern);
+	CFStringGetCharacters(pattern, CFRangeMake(0, pattern_length), pattern_chars);
+	URegularExpression *uregexp = uregex_open(pattern_chars, (int32_t)pattern_length, 0, &parse_error, &status);
+	CFStringRef text = CFSTR("-abcdefghijklmno-");
+	UniChar text_chars[32];
+	CFIndex text_length = CFStringGetLength(text);
+	CFStringGetCharacters(text, CFRangeMake(0, text_length), text_chars);
+	uregex_setText(uregexp, text_chars, (int32_t)text_length, &status);
+	
+	// U+0663 is ARABIC-INDIC DIGIT THREE and U+1D7D1 is MATHEMATICAL BOLD DIGIT THREE, decimal digits for ICU.
+	const char *replacements[] = {"$19", "$15$16", "$0$00", "$1\xD9\xA3", "$\xD9\xA3", "$\xF0\x9D\x9F\x91",
+		"${last}9", "\\$1\\u0041", "$", "$x"};
+	for (size_t n = 0; n < sizeof(replacements)/sizeof(char *); n++) {
+		CFStringRef replacement = CFStringCreateWithCString(kCFAllocatorDefault, replacements[n], kCFStringEncodingUTF8);
+		UniChar replacement_chars[32];
+		CFIndex replacement_length = CFStringGetLength(replacement);
+		CFStringGetCharacters(replacement, CFRangeMake(0, replacement_length), replacement_chars);
+		UErrorCode icu_status = U_ZERO_ERROR;
+		UniChar icu_result[128];
+		int32_t icu_length = uregex_replaceAll(uregexp, replacement_chars, (int32_t)replacement_length,
+											   icu_result, 128, &icu_status);
+		UErrorCode tx_status = U_ZERO_ERROR;
+		CFStringRef result = CFStringCreateByReplacingAllMatches(text, regexp, replacement, &tx_status);
+		CFStringRef expected = (U_ZERO_ERROR == icu_status) ?
+				CFStringCreateWithCharacters(kCFAllocatorDefault, icu_result, icu_length) : NULL;
+		Boolean same = (tx_status == icu_status) && (!expected || (result && CFEqual(result, expected)));
+		fprintf(stderr, "%s : status %d, ICU status %d\n", same ? "same" : "DIFFERENT", tx_status, icu_status);
+		if (result) CFShow(result);
+		if (expected) CFRelease(expected);
+		if (result) CFRelease(result);
+		CFRelease(replacement);
+	}
+	uregex_close(uregexp);
+	CFRelease(regexp);
+}
+
+void test_CFStringAppendByReplacingMatches()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("(?<name>[a-z]+)-([0-9]+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFMutableStringRef string = CFStringCreateMutable(kCFAllocatorDefault, 0);
+	CFStringAppend(string, CFSTR("result : "));
+	CFIndex count = CFStringAppendByReplacingMatches(string, CFSTR("abc-1 de-23 f-456"), regexp,
+													 CFSTR("$2:${name}\\$"), true, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on CFStringAppendByReplacingMatches with UErrorCode : %d\n", status);
+		return;
+	}
+	fprintf(stderr, "replaced : %ld\n", count);
+	CFShow(string);
+	CFRelease(string);
+	CFRelease(regexp);
+}
+
+Boolean DoubleNumber(TXRegexRef regexp, const UniChar *characters, const CFRange *ranges,
+					 CFIndex count, TXRegexOutputRef output, void *info)
+{
+	long value = 0;
+	for (CFIndex n = ranges[0].location; n < ranges[0].location + ranges[0].length; n++) {
+		value = value*10 + (characters[n] - '0');
+	}
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%ld", value*2);
+	UniChar uchars[32];
+	for (int n = 0; n < length; n++) uchars[n] = buffer[n];
+	TXRegexOutputAppendCharacters(output, uchars, length);
+	(*(CFIndex *)info)++;
+	return true;
+}
+
+void test_CFStringCreateByReplacingMatchesWithCallback()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("[0-9]+"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFIndex count = 0;
+	CFStringRef string = CFStringCreateByReplacingMatchesWithCallback(CFSTR("1 apple, 12 lemons and 250 g"), regexp,
+																	  DoubleNumber, &count, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on CFStringCreateByReplacingMatchesWithCallback with UErrorCode : %d\n", status);
+		return;
+	}
+	fprintf(stderr, "replaced : %ld\n", count);
+	CFShow(string);
+	CFRelease(string);
+	CFRelease(regexp);
+}
+
+void test_TXRegexNextMatchRanges()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("(a+)(x)?"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	
+	TXRegexSetString(regexp, CFSTR("aa bb aaa"), &status);
+	CFRange ranges[3];
+	CFIndex gcount;
+	while ((gcount = TXRegexNextMatchRanges(regexp, ranges, 3, &status))) {
+		if (status != U_ZERO_ERROR) {
+			fprintf(stderr, "Error on TXRegexNextMatchRanges with UErrorCode : %d\n", status);
+			break;
+		}
+		for (CFIndex n = 0; n < gcount; n++) {
+			fprintf(stderr, "group %ld : location %ld, length %ld\n", n, ranges[n].location, ranges[n].length);
+		}
+		CFStringRef text = TXRegexCopySubstring(regexp, ranges[0], &status);
+		CFShow(text);
+		CFRelease(text);
+	}
+	CFRelease(regexp);
+}
+
+void test_CFStringIsMatchedWithPattern()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	for (int n = 0; n < 3; n++) {
+		Boolean result = CFStringIsMatchedWithPattern(CFSTR("aaa"), CFSTR("a+"), 0, &parse_error, &status);
+		if (status != U_ZERO_ERROR) {
+			fprintf(stderr, "Error on CFStringIsMatchedWithPattern with UErrorCode : %d\n", status);
+			return;
+		}
+		fprintf(stderr, "matched : %d\n", result);
+	}
+	TXRegexCacheStatistics statistics;
+	TXRegexCacheGetStatistics(&statistics);
+	fprintf(stderr, "hits : %ld, misses : %ld, evictions : %ld, count : %ld\n",
+			statistics.hits, statistics.misses, statistics.evictions, statistics.count);
+}
+
+void test_TXRegexPatternCheckOutMatcher()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexPatternRef pattern = TXRegexPatternCreate(kCFAllocatorDefault, CFSTR("a+"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexPatternCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	
+	TXRegexRef matcher1 = TXRegexPatternCheckOutMatcher(pattern, &status);
+	TXRegexRef matcher2 = TXRegexPatternCheckOutMatcher(pattern, &status);
+	CFArrayRef array1 = TXRegexAllMatchesInString(matcher1, CFSTR("aa bb aaa"), &status);
+	CFArrayRef array2 = TXRegexAllMatchesInString(matcher2, CFSTR("ba"), &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesInString with UErrorCode : %d\n", status);
+		return;
+	}
+	// the region set by a borrower does not reach the next borrower.
+	TXRegexSetRegion(matcher1, CFRangeMake(0, 2), false, true, &status);
+	TXRegexPatternCheckInMatcher(pattern, matcher1);
+	TXRegexPatternCheckInMatcher(pattern, matcher2);
+	CFShow(array1);
+	CFShow(array2);
+	CFRelease(array1);
+	CFRelease(array2);
+	TXRegexRef matcher3 = TXRegexPatternCheckOutMatcher(pattern, &status);
+	CFArrayRef array3 = TXRegexAllMatchesInString(matcher3, CFSTR("aa bb aaa"), &status);
+	if (array3) {
+		CFShow(array3);
+		CFRelease(array3);
+	}
+	TXRegexPatternCheckInMatcher(pattern, matcher3);
+	CFRelease(pattern);
+}
+
+void test_TXRegexAllMatchesInStringParallel()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("\\s*(<|>|>=|=<)?\\s*([0-9\\.]+[a-z]?)\\s*"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	
+	CFMutableStringRef text = CFStringCreateMutable(kCFAllocatorDefault, 0);
+	for (int n = 0; n < 200000; n++) {
+		CFStringAppend(text, CFSTR(">= 1.2.3 < 1.2.4a 1.1.1 basename-1a.scpt "));
+	}
+	
+	CFAbsoluteTime start_time = CFAbsoluteTimeGetCurrent();
+	CFArrayRef array1 = TXRegexAllMatchesInString(regexp, text, &status);
+	CFAbsoluteTime sequential_time = CFAbsoluteTimeGetCurrent() - start_time;
+	start_time = CFAbsoluteTimeGetCurrent();
+	CFArrayRef array2 = TXRegexAllMatchesInStringParallel(regexp, text, 64, 0, &status);
+	CFAbsoluteTime parallel_time = CFAbsoluteTimeGetCurrent() - start_time;
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexAllMatchesInStringParallel with UErrorCode : %d\n", status);
+		return;
+	}
+	double megabytes = CFStringGetLength(text) * sizeof(UniChar) / 1e6;
+	fprintf(stderr, "matches : %ld, equal : %d\n", CFArrayGetCount(array2), CFEqual(array1, array2));
+	fprintf(stderr, "sequential : %.1f MB/s, parallel : %.1f MB/s\n",
+			megabytes/sequential_time, megabytes/parallel_time);
+	CFRelease(array1);
+	CFRelease(array2);
+	CFRelease(text);
+	CFRelease(regexp);
+}
+
+static Boolean CountStreamMatch(TXRegexRef regexp, const CFRange *ranges, CFIndex count, void *info)
+{
+	CFIndex *match_count = (CFIndex *)info;
+	(*match_count)++;
+	return true;
+}
+
+void test_TXRegexScanFileDescriptor()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("\\s*(<|>|>=|=<)?\\s*([0-9\\.]+[a-z]?)\\s*"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	
+	FILE *file = tmpfile();
+	CFMutableStringRef text = CFStringCreateMutable(kCFAllocatorDefault, 0);
+	for (int n = 0; n < 1000; n++) {
+		fputs(">= 1.2.3 < 1.2.4a 1.1.1 basename-1a.scpt \xE3\x81\x82\xF0\x9F\x98\x80 ", file);
+		CFStringAppend(text, CFSTR(">= 1.2.3 < 1.2.4a 1.1.1 basename-1a.scpt "));
+		CFStringAppendCString(text, "\xE3\x81\x82\xF0\x9F\x98\x80 ", kCFStringEncodingUTF8);
+	}
+	rewind(file);
+	
+	CFIndex match_count = 0;
+	CFIndex result = TXRegexScanFileDescriptor(regexp, fileno(file), 1024, CountStreamMatch, &match_count, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexScanFileDescriptor with UErrorCode : %d\n", status);
+		return;
+	}
+	CFArrayRef array = TXRegexAllMatchesInString(regexp, text, &status);
+	fprintf(stderr, "stream matches : %ld, string matches : %ld\n", result, CFArrayGetCount(array));
+	CFRelease(array);
+	CFRelease(text);
+	fclose(file);
+	CFRelease(regexp);
+}
+
+void test_TXRegexSetFile()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	
+	char path[] = "/tmp/TXRegexSetFile.XXXXXX";
+	int fd = mkstemp(path);
+	const char *contents = "\xE3\x81\x82 basename-1a.scpt \xF0\x9F\x98\x80 basename.txt";
+	write(fd, contents, strlen(contents));
+	close(fd);
+	
+	CFRange ranges[3];
+	TXRegexSetFile(regexp, path, &status);
+	TXRegexSetOffsetUnit(regexp, kTXRegexOffsetUTF8Bytes);
+	for (CFIndex count = TXRegexFirstMatchRanges(regexp, 0, ranges, 3, &status); count > 0;
+		 count = TXRegexNextMatchRanges(regexp, ranges, 3, &status)) {
+		fprintf(stderr, "bytes : {%ld, %ld}\n", ranges[0].location, ranges[0].length);
+	}
+	TXRegexSetOffsetUnit(regexp, kTXRegexOffsetUTF16);
+	for (CFIndex count = TXRegexFirstMatchRanges(regexp, 0, ranges, 3, &status); count > 0;
+		 count = TXRegexNextMatchRanges(regexp, ranges, 3, &status)) {
+		CFStringRef text = TXRegexCopySubstring(regexp, ranges[2], &status);
+		fprintf(stderr, "UTF-16 : {%ld, %ld}, extension : ", ranges[0].location, ranges[0].length);
+		CFShow(text);
+		CFRelease(text);
+	}
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexSetFile with UErrorCode : %d\n", status);
+	}
+	unlink(path);
+	CFRelease(regexp);
+}
+
+void test_TXRegexSetMatchString()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	CFIndex error_index = kCFNotFound;
+	
+	CFStringRef patterns[] = {CFSTR("basename(-[0-9a-z]+)?\\.scpt"), CFSTR("[0-9]+\\.[0-9]+"),
+								CFSTR("error: (.*)"), CFSTR("^>=")};
+	CFArrayRef array = CFArrayCreate(kCFAllocatorDefault, (const void **)patterns, 4, &kCFTypeArrayCallBacks);
+	TXRegexSetRef set = TXRegexSetCreate(kCFAllocatorDefault, array, 0, &parse_error, &error_index, &status);
+	CFRelease(array);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexSetCreate at %ld with UErrorCode : %d\n", error_index, status);
+		return;
+	}
+	
+	Boolean matched[4];
+	CFRange ranges[4];
+	CFIndex count = TXRegexSetMatchString(set, CFSTR(">= 1.2.3 < 1.2.4a 1.1.1 basename-1a.scpt"), matched, ranges, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexSetMatchString with UErrorCode : %d\n", status);
+		return;
+	}
+	fprintf(stderr, "matched patterns : %ld\n", count);
+	for (CFIndex n = 0; n < 4; n++) {
+		fprintf(stderr, "%ld : %d {%ld, %ld}\n", n, matched[n], ranges[n].location, ranges[n].length);
+	}
+	CFRelease(set);
+}
+
+void test_TXRegexRequiredLiteral()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.scpt"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFMutableStringRef text = CFStringCreateMutable(kCFAllocatorDefault, 0);
+	for (int n = 0; n < 100000; n++) {
+		CFStringAppend(text, CFSTR("basenam-1a.scp "));
+	}
+	CFStringAppend(text, CFSTR("basename-1a.scpt basename.scpt"));
+	
+	clock_t start = clock();
+	CFIndex count = 0;
+	CFArrayRef array = TXRegexAllMatchesInString(regexp, text, &status);
+	if (array) {
+		count = CFArrayGetCount(array);
+		CFRelease(array);
+	}
+	fprintf(stderr, "%ld matches in %.3f sec\n", count, (double)(clock() - start)/CLOCKS_PER_SEC);
+	CFRelease(text);
+	CFRelease(regexp);
+}
+
+void test_TXRegexGetStatistics()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexSetStatisticsEnabled(true);
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.scpt"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef text = CFSTR("basename-1a.scpt basenam.scpt basename.scpt");
+	CFArrayRef array = TXRegexAllMatchesInString(regexp, text, &status);
+	if (array) CFRelease(array);
+	CFStringRef result = CFStringCreateByReplacingAllMatches(text, regexp, CFSTR("[$1]"), &status);
+	if (result) CFRelease(result);
+	CFStringIsMatchedWithRegex(CFSTR("no scripts"), regexp, &status);
+	// a copy counts into the same statistics.
+	TXRegexRef copy = TXRegexCreateCopy(kCFAllocatorDefault, regexp, &status);
+	if (copy) {
+		CFStringIsMatchedWithRegex(CFSTR("basename.scpt"), copy, &status);
+		CFRelease(copy);
+	}
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexGetStatistics with UErrorCode : %d\n", status);
+	}
+	
+	TXRegexStatistics statistics;
+	TXRegexGetStatistics(regexp, &statistics);
+	fprintf(stderr, "compile : %ld ns\n", statistics.compileNanoseconds);
+	fprintf(stderr, "copied targets : %ld, bytes : %ld\n", statistics.copiedTargets, statistics.copiedBytes);
+	fprintf(stderr, "searches : %ld, matches : %ld, %ld ns\n", statistics.searches, statistics.matches, statistics.searchNanoseconds);
+	fprintf(stderr, "literal rejections : %ld, output growths : %ld\n", statistics.literalRejections, statistics.outputGrowths);
+	TXRegexSetStatisticsEnabled(false);
+	CFRelease(regexp);
+}
+
+void test_TXRegexArchive()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	CFStringRef patterns[] = {CFSTR("basename(-[0-9a-z]+)?\\.scpt"), CFSTR("[0-9]+\\.[0-9]+"), CFSTR("ERROR (\\w+)")};
+	uint32_t options[] = {0, 0, UREGEX_CASE_INSENSITIVE};
+	CFMutableArrayRef regexps = CFArrayCreateMutable(kCFAllocatorDefault, 3, &kCFTypeArrayCallBacks);
+	for (int n = 0; n < 3; n++) {
+		TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, patterns[n], options[n], &parse_error, &status);
+		if (status != U_ZERO_ERROR) {
+			fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+			CFRelease(regexps);
+			return;
+		}
+		CFArrayAppendValue(regexps, regexp);
+		CFRelease(regexp);
+	}
+	
+	char path[] = "/tmp/TXRegexArchive.XXXXXX";
+	close(mkstemp(path));
+	TXRegexArchiveWriteFile(regexps, path, &status);
+	CFRelease(regexps);
+	TXRegexArchiveRef archive = TXRegexArchiveCreateWithFile(kCFAllocatorDefault, path, &status);
+	unlink(path);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexArchiveCreateWithFile with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef text = CFSTR("error basename-1a.scpt 1.2");
+	for (CFIndex n = 0; n < TXRegexArchiveGetCount(archive); n++) {
+		TXRegexRef regexp = TXRegexArchiveGetRegexAtIndex(archive, n, &parse_error, &status);
+		if (!regexp) break;
+		CFArrayRef array = TXRegexFirstMatchInString(regexp, text, 0, &status);
+		if (array) {
+			CFShow(array);
+			CFRelease(array);
+		}
+	}
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexArchiveGetRegexAtIndex with UErrorCode : %d\n", status);
+	}
+	CFRelease(archive);
+}
+
+void test_TXRegexMatchBatch()
+{
+	UParseError parse_error;
+	UErrorCode status = U_ZERO_ERROR;
+	
+	TXRegexRef regexp = TXRegexCreate(kCFAllocatorDefault, CFSTR("basename(-[0-9a-z]+)?\\.(\\w+)"), 0, &parse_error, &status);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on RegexCreate with UErrorCode : %d\n", status);
+		return;
+	}
+	CFStringRef texts[] = {CFSTR("basename-1a.scpt"), CFSTR("no match"), CFSTR("a basename.txt")};
+	TXRegexBatchRef batch = TXRegexMatchBatch(kCFAllocatorDefault, regexp, texts, 3, 0, &status);
+	CFRelease(regexp);
+	if (status != U_ZERO_ERROR) {
+		fprintf(stderr, "Error on TXRegexMatchBatch with UErrorCode : %d\n", status);
+		return;
+	}
+	const TXRegexBatchResults *results = TXRegexBatchGetResults(batch);
+	fprintf(stderr, "matched strings : %ld of %ld\n", results->matchCount, results->count);
+	for (CFIndex m = 0; m < results->matchCount; m++) {
+		fprintf(stderr, "string %ld :", results->indexes[m]);
+		for (CFIndex g = 0; g < results->groupCount; g++) {
+			CFRange range = results->ranges[m * results->groupCount + g];
+			fprintf(stderr, " {%ld, %ld}", range.location, range.length);
+		}
+		fputc('\n', stderr);
+	}
+	CFRelease(batch);
+}
+
 void test_fprintfPaseError()
 {
 	UParseError parse_error;
@@ -181,12 +940,36 @@ void test_fprintfPaseError()
 int main (int argc, const char * argv[]) {
 	test_RegexFirstMatchInString();
 	//test_TXRegexAllMatchesInString();
+	//test_TXRegexCountMatches();
+	//test_TXRegexSetGroupMode();
+	//test_TXRegexLiteralPattern();
+	//test_TXRegexSetTimeLimit();
+	//test_TXRegexArenaCreate();
+	//test_TXRegexSetRegion();
+	//test_TXRegexMatchIndexCreate();
+	//test_TXRegexSetResultCacheCapacity();
+	//test_TXRegexAllMatchesAsync();
 	//test_CFStringCreateArrayWithFirstMatch();
 	//test_CFStringCreateArrayWithFirstMatch2();
 	//test_CFStringCreateArrayWithAllMatches();
 	//test_CFStringCreateArrayByRegexSplitting();
+	//test_TXRegexSplitCreate();
 	//test_CFStringCreateByReplacingFirstMatch();
 	//test_CFStringCreateByReplacingAllMatches();
+	//test_CFStringCreateByReplacingAllMatchesWithICU();
+	//test_CFStringAppendByReplacingMatches();
+	//test_CFStringCreateByReplacingMatchesWithCallback();
+	//test_TXRegexNextMatchRanges();
+	//test_CFStringIsMatchedWithPattern();
+	//test_TXRegexPatternCheckOutMatcher();
+	//test_TXRegexAllMatchesInStringParallel();
+	//test_TXRegexMatchBatch();
+	//test_TXRegexScanFileDescriptor();
+	//test_TXRegexSetFile();
+	//test_TXRegexSetMatchString();
+	//test_TXRegexRequiredLiteral();
+	//test_TXRegexGetStatistics();
+	//test_TXRegexArchive();
 	//test_fprintfPaseError();
 	return 0;
 }